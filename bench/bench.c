@@ -0,0 +1,120 @@
+#include "bench.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Minimum wall time for the measured run of each benchmark. */
+#define BENCH_MIN_NS 200000000ULL
+#define BENCH_MAX_ITERS (1UL << 24)
+
+static const char *filter = NULL;
+static char dir[] = "/tmp/mythsh-bench-XXXXXX";
+
+/* Count allocations by interposing the allocator. glibc routes its own
+   internal allocations (strdup, fopen, ...) through these too. */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long alloc_count = 0;
+
+void *malloc(size_t size) {
+  alloc_count++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+  alloc_count++;
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  alloc_count++;
+  return __libc_realloc(ptr, size);
+}
+#define HAVE_ALLOC_COUNT 1
+#else
+static unsigned long alloc_count = 0;
+#define HAVE_ALLOC_COUNT 0
+#endif
+
+static unsigned long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+const char *bench_dir(void) { return dir; }
+
+void bench_run(const char *name, bench_fn fn, void *arg) {
+  if (filter && !strstr(name, filter))
+    return;
+
+  /* benchmarked code may print; keep the report readable */
+  fflush(stdout);
+  int saved_stdout = dup(STDOUT_FILENO);
+  int devnull = open("/dev/null", O_WRONLY);
+  dup2(devnull, STDOUT_FILENO);
+  close(devnull);
+
+  fn(arg); // warm-up
+
+  unsigned long iters = 1;
+  unsigned long long elapsed;
+  unsigned long allocs;
+  while (1) {
+    unsigned long before = alloc_count;
+    unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++)
+      fn(arg);
+    elapsed = now_ns() - start;
+    allocs = alloc_count - before;
+    if (elapsed >= BENCH_MIN_NS || iters >= BENCH_MAX_ITERS)
+      break;
+    iters *= 2;
+  }
+
+  fflush(stdout);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+
+  printf("%-32s %10lu %14.1f ns/op", name, iters, (double)elapsed / iters);
+  if (HAVE_ALLOC_COUNT)
+    printf(" %12.1f allocs/op\n", (double)allocs / iters);
+  else
+    printf(" %12s allocs/op\n", "-");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    filter = argv[1];
+
+  if (!mkdtemp(dir)) {
+    perror("mythsh_bench: mkdtemp");
+    return 1;
+  }
+  /* todo files live under $HOME, prompts show the cwd */
+  setenv("HOME", dir, 1);
+  if (chdir(dir) != 0) {
+    perror("mythsh_bench: chdir");
+    return 1;
+  }
+
+  printf("%-32s %10s %20s %22s\n", "benchmark", "iters", "time", "allocs");
+  bench_prompt();
+  bench_parse();
+  bench_history();
+  bench_histdb();
+  bench_todo();
+
+  char cmd[sizeof(dir) + 16];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  if (system(cmd) != 0)
+    fprintf(stderr, "mythsh_bench: could not remove %s\n", dir);
+  return 0;
+}
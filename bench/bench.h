@@ -0,0 +1,19 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* One benchmark iteration. Called repeatedly until the run is long enough to
+   give a stable ns/op figure; stdout is sent to /dev/null meanwhile. */
+typedef void (*bench_fn)(void *arg);
+
+void bench_run(const char *name, bench_fn fn, void *arg);
+
+/* Scratch directory the benchmarks run in (also used as $HOME). */
+const char *bench_dir(void);
+
+void bench_prompt(void);
+void bench_parse(void);
+void bench_history(void);
+void bench_histdb(void);
+void bench_todo(void);
+
+#endif
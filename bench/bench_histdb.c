@@ -0,0 +1,68 @@
+#include "bench.h"
+#include "histdb.h"
+#include <limits.h>
+#include <stdio.h>
+
+#define HISTDB_RECORDS 100000
+
+static void record(void *arg) {
+  struct histdb *db = arg;
+  struct timeval start = {1700000000, 0}, end = {1700000001, 500000};
+  struct rusage ru = {0};
+  histdb_record(db, "make -j8", "/home/user/src/mythsh", &start, &end, 0,
+                &ru);
+}
+
+static void query_failed_in_dir(void *arg) {
+  struct histdb_query q = {.cwd = "/home/user/project7", .failed = true,
+                           .limit = 20};
+  histdb_query(arg, &q, stdout);
+}
+
+static void query_failed(void *arg) {
+  struct histdb_query q = {.failed = true, .limit = 20};
+  histdb_query(arg, &q, stdout);
+}
+
+static void query_slow(void *arg) {
+  struct histdb_query q = {.min_duration_ms = 9990, .limit = 20};
+  histdb_query(arg, &q, stdout);
+}
+
+/* A fresh handle indexes the whole log on its first query. */
+static void index_build(void *arg) {
+  struct histdb *db = histdb_open(arg);
+  if (!db)
+    return;
+  struct histdb_query none = {.cwd = "/nowhere"};
+  histdb_query(db, &none, stdout);
+  histdb_close(db);
+}
+
+void bench_histdb(void) {
+  static char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/bench_histdb", bench_dir());
+  struct histdb *db = histdb_open(path);
+  if (!db)
+    return;
+
+  struct rusage ru = {0};
+  for (int i = 0; i < HISTDB_RECORDS; i++) {
+    char cwd[64];
+    snprintf(cwd, sizeof(cwd), "/home/user/project%d", i % 50);
+    struct timeval start = {1700000000 + i, 0};
+    struct timeval end = {start.tv_sec + (i % 10), (i % 1000) * 1000};
+    histdb_record(db, "cargo build --release", cwd, &start, &end, i % 7 == 0,
+                  &ru);
+  }
+  /* the first query waits for the writer and builds the index */
+  struct histdb_query none = {.cwd = "/nowhere"};
+  histdb_query(db, &none, stdout);
+
+  bench_run("histdb/index-build", index_build, path);
+  bench_run("histdb/query-failed-in-dir", query_failed_in_dir, db);
+  bench_run("histdb/query-failed", query_failed, db);
+  bench_run("histdb/query-slow", query_slow, db);
+  bench_run("histdb/record", record, db);
+  histdb_close(db);
+}
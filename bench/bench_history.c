@@ -0,0 +1,52 @@
+#include "bench.h"
+#include "history.h"
+#include "shell.h"
+#include <stdio.h>
+
+#define HISTORY_LINES 100000
+#define HISTORY_UNIQUE 5000
+
+static char path[PATH_MAX];
+
+/* A history file with many repeated commands, like a real one. */
+static void write_history_file(void) {
+  snprintf(path, sizeof(path), "%s/bench_history", bench_dir());
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return;
+  for (int i = 0; i < HISTORY_LINES; i++)
+    fprintf(f, "git commit -m \"change number %d\" --no-verify\n",
+            i % HISTORY_UNIQUE);
+  fclose(f);
+}
+
+static void load(void *arg) {
+  struct history *h = arg;
+  history_init(h);
+  history_load(h, path);
+  history_free(h);
+}
+
+static void search(void *arg) {
+  struct history *h = arg;
+  history_find(h, "no such command", h->count);
+}
+
+/* re-adding an existing command moves it to the front */
+static void add_repeat(void *arg) {
+  struct history *h = arg;
+  history_add(h, history_get(h, 0));
+}
+
+void bench_history(void) {
+  struct history h;
+
+  write_history_file();
+  bench_run("history/load", load, &h);
+
+  history_init(&h);
+  history_load(&h, path);
+  bench_run("history/search-miss", search, &h);
+  bench_run("history/add-repeat", add_repeat, &h);
+  history_free(&h);
+}
@@ -0,0 +1,41 @@
+#include "bench.h"
+#include "shell.h"
+#include <string.h>
+
+static void tokenize(void *arg) {
+  const char *line = arg;
+  char input[MAX_INPUTS];
+  char *args[MAX_ARGS];
+  strcpy(input, line);
+  parse_input(input, args);
+}
+
+static struct mythsh sh;
+static struct strbuf store;
+
+/* Expand and tokenize, as the main loop does. */
+static void command(void *arg) {
+  char *args[MAX_ARGS];
+  parse_command(&sh, arg, &store, args);
+}
+
+/* Find the handler for a command name. */
+static void lookup(void *arg) { cmdmap_get(&sh.commands, arg); }
+
+void bench_parse(void) {
+  bench_run("parse/short", tokenize, "ls -la");
+  bench_run("parse/long", tokenize,
+            "git log --oneline --graph --decorate --all -n 50 "
+            "-- src/mythSh.c src/todo.c src/todo.h Makefile README.md");
+
+  mythsh_init(&sh);
+  cmdmap_set_alias(&sh.commands, "gl", "git log --oneline");
+  cmdmap_set_alias(&sh.commands, "glg", "gl --graph --decorate");
+  bench_run("parse/no-alias", command, "ls -la");
+  bench_run("parse/alias-chain", command, "glg -n 50");
+  bench_run("dispatch/builtin", lookup, "setprompt");
+  bench_run("dispatch/external", lookup, "ls");
+  bench_run("parse/subst", command, "echo $(true)");
+  strbuf_free(&store);
+  mythsh_free(&sh);
+}
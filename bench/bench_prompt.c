@@ -0,0 +1,38 @@
+#include "bench.h"
+#include "shell.h"
+#include <string.h>
+
+#define PROMPT_TEMPLATE "╭─%u%h%d%g\n╰─> "
+
+static void render(void *arg) {
+  struct mythsh *sh = arg;
+  build_prompt(sh, sh->current_prompt_template, sh->current_prompt);
+}
+
+static void measure(void *arg) { prompt_width(arg); }
+
+static void run_theme(const char *name, const char *theme,
+                      const char *template) {
+  static struct mythsh sh;
+  mythsh_init(&sh);
+  sh.theme = theme_find(&sh, theme);
+  strcpy(sh.current_prompt_template, template);
+  sh.has_prompt_template = true;
+  bench_run(name, render, &sh);
+  mythsh_free(&sh);
+}
+
+void bench_prompt(void) {
+  run_theme("prompt/mini", "mini", PROMPT_TEMPLATE);
+  run_theme("prompt/graphic", "graphic", PROMPT_TEMPLATE);
+  /* the command runs once; later renders hit the cache */
+  run_theme("prompt/subst-cached", "mini", PROMPT_TEMPLATE "$(echo ok) ");
+
+  struct mythsh sh;
+  mythsh_init(&sh);
+  char prompt[MAX_PROMPT];
+  build_prompt(&sh, "%u%h%d%g > ", prompt);
+  bench_run("prompt/width", measure, prompt);
+  bench_run("prompt/width-cjk", measure, "\033[1m漢字かなカナ한글\033[0m ❯ ");
+  mythsh_free(&sh);
+}
@@ -0,0 +1,53 @@
+#include "bench.h"
+#include "shell.h"
+#include "todo.h"
+#include <stdio.h>
+
+#define TODO_TASKS 10000
+
+/* todo.c keeps its file in $HOME, which bench.c points at the scratch dir. */
+static void write_todo_file(void) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/.myth_todo", bench_dir());
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return;
+  for (int i = 0; i < TODO_TASKS; i++)
+    fprintf(f, "task number %d: review the pull request\n", i);
+  fclose(f);
+}
+
+static void list(void *arg) {
+  (void)arg;
+  todo_list();
+}
+
+/* add + done keeps the file at a constant size across iterations */
+static void add_done(void *arg) {
+  (void)arg;
+  todo_add("one more task");
+  todo_done(TODO_TASKS + 1);
+}
+
+/* a whole 'todo list >file' line: parse, redirect in-process, restore */
+static void export(void *arg) {
+  struct mythsh *sh = arg;
+  static struct strbuf store;
+  struct redirs redirs;
+  char *args[MAX_ARGS];
+  parse_command(sh, "todo list >todo_export.txt", &store, args);
+  if (parse_redirects(args, &redirs))
+    handle_builtin(sh, args, &redirs);
+  redirs_free(&redirs);
+}
+
+void bench_todo(void) {
+  write_todo_file();
+  bench_run("todo/list", list, NULL);
+  bench_run("todo/add+done", add_done, NULL);
+
+  static struct mythsh sh;
+  mythsh_init(&sh);
+  bench_run("todo/list>file", export, &sh);
+  mythsh_free(&sh);
+}
@@ -0,0 +1,451 @@
+#include "shell.h"
+#include "todo.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Join args[from..] with single spaces, the way commands that take free text
+   (todo add, setprompt, alias, ...) read the rest of the line. */
+static void join_args(char **args, int from, char *out, size_t size) {
+  size_t pos = 0;
+  out[0] = '\0';
+  for (int k = from; args[k] != NULL; k++) {
+    size_t need = strlen(args[k]);
+    if (pos + need + 2 >= size)
+      break;
+    if (pos != 0)
+      out[pos++] = ' ';
+    memcpy(&out[pos], args[k], need);
+    pos += need;
+    out[pos] = '\0';
+  }
+}
+
+/* "90", "15m", "2h", "3d" -> seconds, or -1 if malformed */
+static long parse_seconds(const char *s) {
+  char *end;
+  long v = strtol(s, &end, 10);
+  if (end == s || v < 0)
+    return -1;
+  switch (*end) {
+  case '\0':
+  case 's':
+    break;
+  case 'm':
+    v *= 60;
+    break;
+  case 'h':
+    v *= 3600;
+    break;
+  case 'd':
+    v *= 86400;
+    break;
+  default:
+    return -1;
+  }
+  if (*end != '\0' && end[1] != '\0')
+    return -1;
+  return v;
+}
+
+static void hist_usage(void) {
+  printf("Usage: hist on [file] | hist off\n"
+         "       hist [-d dir] [-s age] [-u age] [-e code] [-f] [-t ms] "
+         "[-n count]\n"
+         "  -d  ran in dir        -s/-u  started after/before age ago "
+         "(e.g. 90s, 15m, 2h, 3d)\n"
+         "  -e  exited with code  -f     failed (non-zero exit)\n"
+         "  -t  took at least ms  -n     show at most count (default 20)\n");
+}
+
+/* hist: enable the structured history log or query it */
+static int builtin_hist(struct mythsh *sh, char **args) {
+  if (args[1] != NULL && strcmp(args[1], "on") == 0) {
+    char path[PATH_MAX];
+    if (args[2] != NULL) {
+      snprintf(path, sizeof(path), "%s", args[2]);
+    } else {
+      const char *home = getenv("HOME");
+      snprintf(path, sizeof(path), "%s/%s", home ? home : ".", HISTDB_FILE);
+    }
+    histdb_close(sh->histdb);
+    sh->histdb = histdb_open(path);
+    if (!sh->histdb) {
+      fprintf(stderr, "mythsh: hist: %s: %s\n", path, strerror(errno));
+      return 1;
+    }
+    return 0;
+  }
+  if (args[1] != NULL && strcmp(args[1], "off") == 0) {
+    histdb_close(sh->histdb);
+    sh->histdb = NULL;
+    return 0;
+  }
+
+  struct histdb_query q = {.limit = 20};
+  char cwd[PATH_MAX];
+  time_t now = time(NULL);
+  for (int k = 1; args[k] != NULL; k++) {
+    const char *opt = args[k];
+    if (strcmp(opt, "-f") == 0) {
+      q.failed = true;
+      continue;
+    }
+    const char *val = args[k + 1];
+    if (val == NULL || opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0') {
+      hist_usage();
+      return 1;
+    }
+    k++;
+    long secs;
+    switch (opt[1]) {
+    case 'd':
+      if (!realpath(val, cwd))
+        snprintf(cwd, sizeof(cwd), "%s", val);
+      q.cwd = cwd;
+      break;
+    case 's':
+    case 'u':
+      if ((secs = parse_seconds(val)) < 0) {
+        hist_usage();
+        return 1;
+      }
+      if (opt[1] == 's')
+        q.since = now - secs;
+      else
+        q.until = now - secs;
+      break;
+    case 'e':
+      q.match_status = true;
+      q.status = atoi(val);
+      break;
+    case 't':
+      q.min_duration_ms = (uint32_t)strtoul(val, NULL, 10);
+      break;
+    case 'n':
+      q.limit = atoi(val);
+      break;
+    default:
+      hist_usage();
+      return 1;
+    }
+  }
+
+  if (!sh->histdb) {
+    printf("hist: logging is off (add 'hist on' to ~/.mythrc)\n");
+    return 1;
+  }
+  if (histdb_query(sh->histdb, &q, stdout) == 0)
+    printf("hist: no matching commands\n");
+  return 0;
+}
+
+static int builtin_exit(struct mythsh *sh, char **args) {
+  (void)sh;
+  (void)args;
+  printf("Goodbye!\n");
+  exit(0);
+}
+
+static int builtin_cd(struct mythsh *sh, char **args) {
+  (void)sh;
+  const char *target = args[1];
+  if (target == NULL) {
+    target = getenv("HOME");
+    if (!target) {
+      fprintf(stderr, "mythsh: cd: HOME not set\n");
+      return 1;
+    }
+  }
+  if (chdir(target) != 0) {
+    perror("mythsh");
+    return 1;
+  }
+  return 0;
+}
+
+/* mood <name>: switch to a predefined prompt
+   mood <name> <prompt...>: define one (escapes as in setprompt) */
+static int builtin_mood(struct mythsh *sh, char **args) {
+  if (args[1] == NULL) {
+    printf("Usage: mood <");
+    for (int i = 0; i < sh->mood_count; i++)
+      printf("%s%s", i ? "|" : "", sh->moods[i].name);
+    printf(">\n");
+    return 1;
+  }
+  if (args[2] != NULL) {
+    char prompt[MAX_PROMPT];
+    join_args(args, 2, prompt, sizeof(prompt));
+    unescape_prompt(prompt, sizeof(prompt));
+    return mood_define(sh, args[1], prompt) ? 0 : 1;
+  }
+  const struct mood *m = mood_find(sh, args[1]);
+  if (!m) {
+    printf("Unknown mood: %s\n", args[1]);
+    return 1;
+  }
+  strncpy(sh->current_prompt, m->prompt, MAX_PROMPT - 1);
+  sh->current_prompt[MAX_PROMPT - 1] = '\0';
+  sh->current_prompt_width = prompt_width(sh->current_prompt);
+  sh->has_prompt_template = false;
+  return 0;
+}
+
+// todo builtins: add/list/done
+static int builtin_todo(struct mythsh *sh, char **args) {
+  (void)sh;
+  if (args[1] == NULL) {
+    printf("Usage: todo [add|list|done]\n");
+  } else if (strcmp(args[1], "add") == 0) {
+    if (args[2] == NULL) {
+      printf("Usage: todo add <task>\n");
+    } else {
+      /* join remaining args into one string so tasks can have spaces */
+      char task[MAX_INPUTS];
+      join_args(args, 2, task, sizeof(task));
+      todo_add(task);
+      return 0;
+    }
+  } else if (strcmp(args[1], "list") == 0) {
+    todo_list();
+    return 0;
+  } else if (strcmp(args[1], "done") == 0) {
+    if (args[2] == NULL) {
+      printf("Usage: todo done <id>\n");
+    } else {
+      todo_done(atoi(args[2]));
+      return 0;
+    }
+  } else {
+    printf("Invalid todo command\n");
+  }
+  return 1;
+}
+
+// setprompt: all remaining args are joined to form the template
+static int builtin_setprompt(struct mythsh *sh, char **args) {
+  if (args[1] == NULL) {
+    printf("Usage: setprompt <template>  (%%u user, %%h host, %%d cwd, "
+           "%%g git branch)\n");
+    return 1;
+  }
+  char new_prompt[MAX_PROMPT];
+  join_args(args, 1, new_prompt, sizeof(new_prompt));
+  unescape_prompt(new_prompt, sizeof(new_prompt));
+  strncpy(sh->current_prompt_template, new_prompt, MAX_PROMPT - 1);
+  sh->current_prompt_template[MAX_PROMPT - 1] = '\0';
+  sh->has_prompt_template = true;
+  sh->current_prompt_width =
+      build_prompt(sh, sh->current_prompt_template, sh->current_prompt);
+  return 0;
+}
+
+/* theme <name>: switch themes
+   theme <name> <user|host|dir|git|nogit> <format...>: define or override a
+   segment; a new theme starts as a copy of mini */
+static int builtin_theme(struct mythsh *sh, char **args) {
+  if (args[1] == NULL) {
+    printf("Usage: theme <");
+    for (int i = 0; i < sh->theme_count; i++)
+      printf("%s%s", i ? "|" : "", sh->themes[i].name);
+    printf(">\n");
+    return 1;
+  }
+  if (args[2] != NULL) {
+    char format[MAX_PROMPT];
+    join_args(args, 3, format, sizeof(format));
+    unescape_prompt(format, sizeof(format));
+    if (!theme_define(sh, args[1], args[2], format)) {
+      printf("Unknown theme segment: %s\n", args[2]);
+      return 1;
+    }
+    return 0;
+  }
+  int t = theme_find(sh, args[1]);
+  if (t < 0) {
+    printf("Unknown theme: %s\n", args[1]);
+    return 1;
+  }
+  sh->theme = t;
+  return 0;
+}
+
+static int cmp_names(const void *a, const void *b) {
+  return strcmp((*(const struct cmd_entry *const *)a)->name,
+                (*(const struct cmd_entry *const *)b)->name);
+}
+
+/* alias: list aliases; alias name: show one; alias name=value...: define */
+static int builtin_alias(struct mythsh *sh, char **args) {
+  if (args[1] == NULL) {
+    const struct cmd_entry **list =
+        malloc((sh->commands.count + 1) * sizeof(*list));
+    if (!list)
+      return 1;
+    size_t n = 0;
+    for (size_t i = 0; i < sh->commands.count; i++) {
+      if (sh->commands.entries[i].alias)
+        list[n++] = &sh->commands.entries[i];
+    }
+    qsort(list, n, sizeof(*list), cmp_names);
+    for (size_t i = 0; i < n; i++)
+      printf("alias %s='%s'\n", list[i]->name, list[i]->alias);
+    free(list);
+    return 0;
+  }
+
+  char def[MAX_INPUTS];
+  join_args(args, 1, def, sizeof(def));
+  char *eq = strchr(def, '=');
+  if (!eq) {
+    const struct cmd_entry *e = cmdmap_get(&sh->commands, def);
+    if (!e || !e->alias) {
+      printf("alias: %s: not found\n", def);
+      return 1;
+    }
+    printf("alias %s='%s'\n", e->name, e->alias);
+    return 0;
+  }
+
+  *eq = '\0';
+  char *value = eq + 1;
+  size_t len = strlen(value);
+  /* the tokenizer doesn't do quoting, so strip a surrounding pair here */
+  if (len >= 2 && (value[0] == '\'' || value[0] == '"') &&
+      value[len - 1] == value[0]) {
+    value[len - 1] = '\0';
+    value++;
+  }
+  if (def[0] == '\0' || strpbrk(def, " \t") != NULL) {
+    printf("alias: invalid name: %s\n", def);
+    return 1;
+  }
+  return cmdmap_set_alias(&sh->commands, def, value) ? 0 : 1;
+}
+
+static int builtin_unalias(struct mythsh *sh, char **args) {
+  if (args[1] == NULL) {
+    printf("Usage: unalias <name>\n");
+    return 1;
+  }
+  int status = 0;
+  for (int k = 1; args[k] != NULL; k++) {
+    if (!cmdmap_unset_alias(&sh->commands, args[k])) {
+      printf("unalias: %s: not found\n", args[k]);
+      status = 1;
+    }
+  }
+  return status;
+}
+
+static const struct {
+  const char *name;
+  builtin_fn fn;
+} builtin_table[] = {
+    {"exit", builtin_exit},
+    {"cd", builtin_cd},
+    {"mood", builtin_mood},
+    {"todo", builtin_todo},
+    {"setprompt", builtin_setprompt},
+    {"theme", builtin_theme},
+    {"hist", builtin_hist},
+    {"alias", builtin_alias},
+    {"unalias", builtin_unalias},
+};
+
+void builtins_register(struct mythsh *sh) {
+  for (size_t i = 0; i < sizeof(builtin_table) / sizeof(builtin_table[0]); i++)
+    cmdmap_set_builtin(&sh->commands, builtin_table[i].name,
+                       builtin_table[i].fn);
+}
+
+/* Run args as a builtin if it is one. Returns 1 if it was handled. The
+   builtin runs in the shell itself; redirections in r (may be NULL) swap
+   its fds for the duration instead of forking. */
+int handle_builtin(struct mythsh *sh, char **args, struct redirs *r) {
+  if (args[0] == NULL)
+    return 0;
+  const struct cmd_entry *e = cmdmap_get(&sh->commands, args[0]);
+  if (!e || !e->builtin)
+    return 0;
+  if (r == NULL || r->count == 0) {
+    e->builtin(sh, args);
+    return 1;
+  }
+
+  /* stdio buffers sit above the fds: flush around the swap */
+  fflush(stdout);
+  if (apply_redirects(r, true))
+    e->builtin(sh, args);
+  fflush(stdout);
+  fflush(stderr);
+  restore_redirects(r);
+  return 1;
+}
+
+/* Here-document lines from the rc file. */
+static bool rc_line(void *ctx, char **buf, size_t *size) {
+  if (getline(buf, size, ctx) < 0)
+    return false;
+  (*buf)[strcspn(*buf, "\n")] = '\0';
+  return true;
+}
+
+void load_myshrc(struct mythsh *sh) {
+  const char *home = getenv("HOME");
+  if (!home)
+    return;
+
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/.mythrc", home);
+
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return; // no rc file, skip
+
+  char *line = NULL;
+  size_t size = 0;
+  struct strbuf expanded = {0};
+  struct redirs redirs;
+  char *args[MAX_ARGS];
+
+  while (getline(&line, &size, file) >= 0) {
+    /* remove trailing newline */
+    line[strcspn(line, "\n")] = 0;
+    /* skip comments and empty lines */
+    size_t len = strlen(line);
+    if (len == 0)
+      continue;
+    /* trim leading whitespace */
+    char *p = line;
+    while (*p && (*p == ' ' || *p == '\t' || *p == '\r'))
+      p++;
+    if (*p == '#' || *p == '\0')
+      continue;
+    /* parse */
+    parse_command(sh, p, &expanded, args);
+    if (!parse_redirects(args, &redirs))
+      continue;
+    read_heredocs(&redirs, rc_line, file);
+    if (args[0] != NULL) {
+      /* treat rc commands as builtins where appropriate */
+      if (!handle_builtin(sh, args, &redirs)) {
+        /* if not builtin, you might want to exec them or ignore; here we ignore
+         */
+        // nah we aint gonna ignore them ... we gonna execute those commands
+        pid_t pid = spawn_command(sh, args, &redirs, -1);
+        if (pid > 0)
+          waitpid(pid, NULL, 0);
+      }
+    }
+    redirs_free(&redirs);
+  }
+  free(line);
+  strbuf_free(&expanded);
+  fclose(file);
+}
@@ -0,0 +1,106 @@
+#include "cmdmap.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+void cmdmap_init(struct cmdmap *m) { memset(m, 0, sizeof(*m)); }
+
+void cmdmap_free(struct cmdmap *m) {
+  for (size_t i = 0; i < m->count; i++) {
+    free(m->entries[i].name);
+    free(m->entries[i].alias);
+  }
+  free(m->entries);
+  hash_index_free(&m->index);
+  memset(m, 0, sizeof(*m));
+}
+
+static bool entry_eq(const void *ctx, int id, const void *key) {
+  const struct cmdmap *m = ctx;
+  const struct cmd_entry *k = key;
+  return m->entries[id].hash == k->hash &&
+         strcmp(m->entries[id].name, k->name) == 0;
+}
+
+static bool entry_hash(const void *ctx, int id, uint32_t *hash) {
+  const struct cmdmap *m = ctx;
+  *hash = m->entries[id].hash;
+  return true;
+}
+
+/* Index slot holding name, or the empty slot where it would go. */
+static size_t find_slot(const struct cmdmap *m, const char *name,
+                        uint32_t hash) {
+  struct cmd_entry key = {.name = (char *)name, .hash = hash};
+  return hash_index_find(&m->index, hash, entry_eq, m, &key);
+}
+
+static struct cmd_entry *find(const struct cmdmap *m, const char *name) {
+  if (m->index.size == 0)
+    return NULL;
+  int id = m->index.slots[find_slot(m, name, fnv1a(name, strlen(name)))];
+  return id >= 0 ? &m->entries[id] : NULL;
+}
+
+const struct cmd_entry *cmdmap_get(const struct cmdmap *m, const char *name) {
+  return find(m, name);
+}
+
+/* Entry for name, created if needed. */
+static struct cmd_entry *upsert(struct cmdmap *m, const char *name) {
+  if (m->index.size == 0 &&
+      !hash_index_rebuild(&m->index, hash_index_size_for(0), 0, entry_hash, m))
+    return NULL;
+  uint32_t hash = fnv1a(name, strlen(name));
+  size_t pos = find_slot(m, name, hash);
+  if (m->index.slots[pos] >= 0)
+    return &m->entries[m->index.slots[pos]];
+
+  if (m->count == m->cap) {
+    size_t cap = m->cap ? m->cap * 2 : 32;
+    struct cmd_entry *entries = realloc(m->entries, cap * sizeof(*entries));
+    if (!entries)
+      return NULL;
+    m->entries = entries;
+    m->cap = cap;
+  }
+  struct cmd_entry *e = &m->entries[m->count];
+  memset(e, 0, sizeof(*e));
+  e->name = strdup(name);
+  if (!e->name)
+    return NULL;
+  e->hash = hash;
+  m->count++;
+  hash_index_set(&m->index, pos, (int)m->count - 1, (int)m->count, entry_hash,
+                 m);
+  return e;
+}
+
+bool cmdmap_set_builtin(struct cmdmap *m, const char *name, builtin_fn fn) {
+  struct cmd_entry *e = upsert(m, name);
+  if (!e)
+    return false;
+  e->builtin = fn;
+  return true;
+}
+
+bool cmdmap_set_alias(struct cmdmap *m, const char *name, const char *value) {
+  char *copy = strdup(value);
+  struct cmd_entry *e = copy ? upsert(m, name) : NULL;
+  if (!e) {
+    free(copy);
+    return false;
+  }
+  free(e->alias);
+  e->alias = copy;
+  return true;
+}
+
+bool cmdmap_unset_alias(struct cmdmap *m, const char *name) {
+  struct cmd_entry *e = find(m, name);
+  if (!e || !e->alias)
+    return false;
+  free(e->alias);
+  e->alias = NULL;
+  return true;
+}
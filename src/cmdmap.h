@@ -0,0 +1,40 @@
+#ifndef CMDMAP_H
+#define CMDMAP_H
+
+#include "hash.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct mythsh;
+
+/* A builtin gets the parsed argv and returns its exit status. */
+typedef int (*builtin_fn)(struct mythsh *sh, char **args);
+
+/* One command name. A name can be a builtin, an alias or both; the alias
+   wins because aliases are expanded before dispatch. */
+struct cmd_entry {
+  char *name;
+  uint32_t hash;
+  builtin_fn builtin;
+  char *alias;
+};
+
+/* Hash map from command name to entry. Names are never removed: unalias
+   only clears the alias, so the index needs no tombstones. */
+struct cmdmap {
+  struct cmd_entry *entries; // in the order names were added
+  size_t count;
+  size_t cap;
+  struct hash_index index; // name -> position in entries
+};
+
+void cmdmap_init(struct cmdmap *m);
+void cmdmap_free(struct cmdmap *m);
+
+const struct cmd_entry *cmdmap_get(const struct cmdmap *m, const char *name);
+bool cmdmap_set_builtin(struct cmdmap *m, const char *name, builtin_fn fn);
+bool cmdmap_set_alias(struct cmdmap *m, const char *name, const char *value);
+bool cmdmap_unset_alias(struct cmdmap *m, const char *name);
+
+#endif
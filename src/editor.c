@@ -0,0 +1,630 @@
+#include "editor.h"
+#include "width.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+/* How long to wait for the rest of an escape sequence before treating ESC as
+   a key on its own. Terminals send whole sequences in one write, so this only
+   matters for a lone ESC press. */
+#define ESC_TIMEOUT_MS 50
+#define PASTE_TIMEOUT_MS 500
+#define READ_CHUNK 4096
+
+#undef CTRL // <sys/ioctl.h> may define an equivalent one
+#define CTRL(c) ((c) & 0x1f)
+
+enum {
+  KEY_IGNORE = 1000,
+  KEY_UP,
+  KEY_DOWN,
+  KEY_LEFT,
+  KEY_RIGHT,
+  KEY_HOME,
+  KEY_END,
+  KEY_DELETE,
+  KEY_WORD_LEFT,
+  KEY_WORD_RIGHT,
+  KEY_PASTE_START,
+  KEY_PASTE_END,
+  KEY_EOF,
+};
+#define KEY_ALT 0x10000 /* OR-ed with the byte that followed a lone ESC */
+
+/* Sequences that follow ESC. Anything not listed here is swallowed whole so it
+   can't leak into the line as literal text. */
+static const struct {
+  const char *seq;
+  int key;
+} esc_table[] = {
+    {"[A", KEY_UP},           {"[B", KEY_DOWN},
+    {"[C", KEY_RIGHT},        {"[D", KEY_LEFT},
+    {"OA", KEY_UP},           {"OB", KEY_DOWN},
+    {"OC", KEY_RIGHT},        {"OD", KEY_LEFT},
+    {"[H", KEY_HOME},         {"[F", KEY_END},
+    {"OH", KEY_HOME},         {"OF", KEY_END},
+    {"[1~", KEY_HOME},        {"[4~", KEY_END},
+    {"[7~", KEY_HOME},        {"[8~", KEY_END},
+    {"[3~", KEY_DELETE},      {"[1;5C", KEY_WORD_RIGHT},
+    {"[1;5D", KEY_WORD_LEFT}, {"[1;3C", KEY_WORD_RIGHT},
+    {"[1;3D", KEY_WORD_LEFT}, {"[200~", KEY_PASTE_START},
+    {"[201~", KEY_PASTE_END},
+};
+
+/* Input is read in chunks so a paste arrives in a handful of read() calls
+   rather than one per byte. */
+static unsigned char inbuf[READ_CHUNK];
+static size_t in_len = 0;
+static size_t in_pos = 0;
+
+/* Make at least one byte available. A negative timeout blocks. Returns false
+   on timeout, EOF or error. */
+static bool fill_input(int timeout_ms) {
+  if (in_pos < in_len)
+    return true;
+  if (timeout_ms >= 0) {
+    struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+    int r;
+    do {
+      r = poll(&pfd, 1, timeout_ms);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0)
+      return false;
+  }
+  ssize_t n;
+  do {
+    n = read(STDIN_FILENO, inbuf, sizeof(inbuf));
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return false;
+  in_len = (size_t)n;
+  in_pos = 0;
+  return true;
+}
+
+static int next_byte(int timeout_ms) {
+  if (!fill_input(timeout_ms))
+    return -1;
+  return inbuf[in_pos++];
+}
+
+/* Decode what follows an ESC byte. */
+static int read_escape(void) {
+  char seq[16];
+  size_t n = 0;
+
+  int c = next_byte(ESC_TIMEOUT_MS);
+  if (c < 0)
+    return KEY_IGNORE; // lone ESC
+  if (c != '[' && c != 'O')
+    return KEY_ALT | c;
+  seq[n++] = (char)c;
+
+  while (n < sizeof(seq) - 1) {
+    c = next_byte(ESC_TIMEOUT_MS);
+    if (c < 0)
+      break;
+    seq[n++] = (char)c;
+    seq[n] = '\0';
+
+    bool prefix = false;
+    for (size_t i = 0; i < sizeof(esc_table) / sizeof(esc_table[0]); i++) {
+      if (strcmp(esc_table[i].seq, seq) == 0)
+        return esc_table[i].key;
+      if (strncmp(esc_table[i].seq, seq, n) == 0)
+        prefix = true;
+    }
+    if (!prefix) {
+      /* unknown CSI: consume up to its final byte */
+      if (seq[0] == '[') {
+        while (c >= 0 && !(c >= 0x40 && c <= 0x7e))
+          c = next_byte(ESC_TIMEOUT_MS);
+      }
+      return KEY_IGNORE;
+    }
+  }
+  return KEY_IGNORE;
+}
+
+static int read_key(void) {
+  int c = next_byte(-1);
+  if (c < 0)
+    return KEY_EOF;
+  if (c == '\033')
+    return read_escape();
+  return c;
+}
+
+/* Output is assembled here and written with a single write() per redraw. */
+struct abuf {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+static void ab_append(struct abuf *ab, const char *s, size_t n) {
+  if (ab->len + n > ab->cap) {
+    size_t cap = ab->cap ? ab->cap * 2 : 256;
+    while (cap < ab->len + n)
+      cap *= 2;
+    char *p = realloc(ab->data, cap);
+    if (!p)
+      return;
+    ab->data = p;
+    ab->cap = cap;
+  }
+  memcpy(ab->data + ab->len, s, n);
+  ab->len += n;
+}
+
+static void ab_puts(struct abuf *ab, const char *s) {
+  ab_append(ab, s, strlen(s));
+}
+
+static void ab_flush(struct abuf *ab) {
+  size_t off = 0;
+  while (off < ab->len) {
+    ssize_t n = write(STDOUT_FILENO, ab->data + off, ab->len - off);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    off += (size_t)n;
+  }
+  free(ab->data);
+  ab->data = NULL;
+  ab->len = ab->cap = 0;
+}
+
+static void write_str(const char *s) {
+  struct abuf ab = {0};
+  ab_puts(&ab, s);
+  ab_flush(&ab);
+}
+
+/* Screen positions are kept as (row, col), with row 0 being the row the last
+   line of the prompt starts on. The prompt itself is only printed once; a
+   redraw rewrites the input from where it starts. */
+struct line {
+  const char *prompt;
+  size_t prompt_cols; // width of the prompt's last line
+  char *buf; // grows as needed; handed back to the caller
+  size_t size;
+  size_t len;
+  size_t pos;
+  size_t cols;     // terminal width at the last redraw
+  size_t row, col; // where the cursor is on screen
+};
+
+static bool is_cont(char c) { return ((unsigned char)c & 0xc0) == 0x80; }
+
+static size_t term_cols(void) {
+  struct winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
+    return ws.ws_col;
+  return 80;
+}
+
+/* Screen position of byte offset n of the line. A wide glyph that doesn't
+   fit at the end of a row moves to the next one, as terminals do, and text
+   that exactly fills a row puts the next position at the start of the next
+   row. */
+static void locate(const struct line *l, size_t n, size_t *row, size_t *col) {
+  size_t r = l->prompt_cols / l->cols;
+  size_t c = l->prompt_cols % l->cols;
+  for (size_t i = 0; i < n;) {
+    uint32_t cp;
+    i += utf8_decode(l->buf + i, n - i, &cp);
+    int w = codepoint_width(cp);
+    if (c + w > l->cols) {
+      r++;
+      c = 0;
+    }
+    c += w;
+  }
+  if (c >= l->cols) {
+    r++;
+    c = 0;
+  }
+  *row = r;
+  *col = c;
+}
+
+/* Append the cursor motion from (l->row, l->col) to (row, col). */
+static void ab_move(struct abuf *ab, struct line *l, size_t row, size_t col) {
+  char seq[32];
+  if (row < l->row) {
+    snprintf(seq, sizeof(seq), "\033[%zuA", l->row - row);
+    ab_puts(ab, seq);
+  } else if (row > l->row) {
+    snprintf(seq, sizeof(seq), "\033[%zuB", row - l->row);
+    ab_puts(ab, seq);
+  }
+  if (col != l->col) {
+    ab_puts(ab, "\r");
+    if (col > 0) {
+      snprintf(seq, sizeof(seq), "\033[%zuC", col);
+      ab_puts(ab, seq);
+    }
+  }
+  l->row = row;
+  l->col = col;
+}
+
+/* Print the prompt and note where the input starts. If the prompt ends
+   exactly at the right margin the terminal holds the cursor there until the
+   next character arrives; step onto the next row so positions stay exact. */
+static void show_prompt(struct line *l) {
+  struct abuf ab = {0};
+  l->cols = term_cols();
+  ab_puts(&ab, l->prompt);
+  if (l->prompt_cols > 0 && l->prompt_cols % l->cols == 0)
+    ab_puts(&ab, "\r\n");
+  ab_flush(&ab);
+  locate(l, 0, &l->row, &l->col);
+}
+
+/* Move the cursor to pos without redrawing anything. */
+static void move_cursor(struct line *l) {
+  struct abuf ab = {0};
+  size_t row, col;
+  locate(l, l->pos, &row, &col);
+  ab_move(&ab, l, row, col);
+  ab_flush(&ab);
+}
+
+/* Redraw the input from the cursor's row downwards (the prompt is left
+   alone), then put the cursor back at pos. */
+static void refresh_line(struct line *l) {
+  struct abuf ab = {0};
+  size_t row, col;
+
+  l->cols = term_cols();
+  locate(l, 0, &row, &col);
+  ab_move(&ab, l, row, col);
+  ab_puts(&ab, "\033[J");
+  ab_append(&ab, l->buf, l->len);
+  locate(l, l->len, &l->row, &l->col);
+  if (l->col == 0 && l->row > row)
+    ab_puts(&ab, "\r\n"); // text ends at the margin; see show_prompt()
+  locate(l, l->pos, &row, &col);
+  ab_move(&ab, l, row, col);
+  ab_flush(&ab);
+}
+
+/* Make room for a line of len bytes plus its terminator. */
+static bool reserve(struct line *l, size_t len) {
+  if (len < l->size)
+    return true;
+  size_t size = l->size ? l->size * 2 : 256;
+  while (size <= len)
+    size *= 2;
+  char *buf = realloc(l->buf, size);
+  if (!buf)
+    return false;
+  l->buf = buf;
+  l->size = size;
+  return true;
+}
+
+/* Insert n bytes at the cursor. Returns false (and inserts nothing) if the
+   buffer can't grow. */
+static bool insert_text(struct line *l, const char *s, size_t n) {
+  if (n == 0)
+    return true;
+  if (!reserve(l, l->len + n))
+    return false;
+  memmove(l->buf + l->pos + n, l->buf + l->pos, l->len - l->pos);
+  memcpy(l->buf + l->pos, s, n);
+  l->pos += n;
+  l->len += n;
+  l->buf[l->len] = '\0';
+  return true;
+}
+
+static void delete_range(struct line *l, size_t from, size_t to) {
+  if (from >= to)
+    return;
+  memmove(l->buf + from, l->buf + to, l->len - to);
+  l->len -= to - from;
+  l->buf[l->len] = '\0';
+  if (l->pos > to)
+    l->pos -= to - from;
+  else if (l->pos > from)
+    l->pos = from;
+}
+
+static size_t prev_char(const struct line *l, size_t pos) {
+  if (pos == 0)
+    return 0;
+  pos--;
+  while (pos > 0 && is_cont(l->buf[pos]))
+    pos--;
+  return pos;
+}
+
+static size_t next_char(const struct line *l, size_t pos) {
+  if (pos >= l->len)
+    return l->len;
+  pos++;
+  while (pos < l->len && is_cont(l->buf[pos]))
+    pos++;
+  return pos;
+}
+
+/* True while the character before the cursor is missing some of its UTF-8
+   bytes, i.e. it is still being typed. */
+static bool partial_char(const struct line *l) {
+  size_t start = prev_char(l, l->pos);
+  unsigned char lead = (unsigned char)l->buf[start];
+  size_t need = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc0 ? 2 : 1;
+  return l->pos - start < need;
+}
+
+static bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+static size_t prev_word(const struct line *l, size_t pos) {
+  while (pos > 0 && is_space(l->buf[pos - 1]))
+    pos--;
+  while (pos > 0 && !is_space(l->buf[pos - 1]))
+    pos--;
+  return pos;
+}
+
+static size_t next_word(const struct line *l, size_t pos) {
+  while (pos < l->len && is_space(l->buf[pos]))
+    pos++;
+  while (pos < l->len && !is_space(l->buf[pos]))
+    pos++;
+  return pos;
+}
+
+static void set_line(struct line *l, const char *text) {
+  size_t len = strlen(text);
+  if (!reserve(l, len))
+    len = l->size - 1;
+  memcpy(l->buf, text, len);
+  l->buf[len] = '\0';
+  l->len = l->pos = len;
+}
+
+/* Collect a bracketed paste up to the closing ESC[201~ and insert it as one
+   chunk, however long. Newlines become spaces so a paste never runs a
+   command on its own; other control bytes are dropped. */
+static void read_paste(struct line *l) {
+  static const char end_marker[] = "\033[201~";
+  struct line chunk = {0}; // just the buffer part
+  bool ok = true;
+
+  while (1) {
+    int c = next_byte(PASTE_TIMEOUT_MS);
+    if (c < 0)
+      break;
+    /* what may follow ESC when it doesn't turn out to be the end marker */
+    const char *matched = "";
+    size_t m = 0;
+    if (c == '\033') {
+      m = 1;
+      while (end_marker[m] != '\0') {
+        c = next_byte(PASTE_TIMEOUT_MS);
+        if (c != end_marker[m])
+          break;
+        m++;
+      }
+      if (end_marker[m] == '\0')
+        break;
+      /* the ESC is dropped like other control bytes; what matched after it
+         is pasted text */
+      matched = end_marker + 1;
+      m--;
+    }
+    ok = ok && reserve(&chunk, chunk.len + m + 1);
+    if (ok) {
+      memcpy(chunk.buf + chunk.len, matched, m);
+      chunk.len += m;
+    }
+    if (c < 0)
+      break;
+    if (c == '\033') {
+      in_pos--; // let the loop look at this ESC again
+      continue;
+    }
+    if (c == '\n' || c == '\r' || c == '\t')
+      c = ' ';
+    else if (c < 0x20 || c == 0x7f)
+      continue;
+    if (ok)
+      chunk.buf[chunk.len++] = (char)c;
+  }
+
+  if (!ok || !insert_text(l, chunk.buf, chunk.len))
+    write_str("\a");
+  free(chunk.buf);
+  refresh_line(l);
+}
+
+static void history_move(struct line *l, const struct history *history,
+                         int *history_index, int dir) {
+  if (dir < 0) {
+    if (*history_index <= 0)
+      return;
+    (*history_index)--;
+    set_line(l, history_get(history, *history_index));
+  } else if (*history_index < history->count - 1) {
+    (*history_index)++;
+    set_line(l, history_get(history, *history_index));
+  } else {
+    set_line(l, "");
+    *history_index = history->count;
+  }
+  refresh_line(l);
+}
+
+int editor_readline(const char *prompt, size_t prompt_cols, char **buf,
+                    size_t *size, const struct history *history,
+                    int *history_index) {
+  struct line l = {.prompt = prompt,
+                   .prompt_cols = prompt_cols,
+                   .buf = *buf,
+                   .size = *buf ? *size : 0,
+                   .len = 0,
+                   .pos = 0};
+  bool tty = isatty(STDOUT_FILENO);
+
+  if (!reserve(&l, 0))
+    return -1;
+  *buf = l.buf;
+  *size = l.size;
+  l.buf[0] = '\0';
+  fflush(stdout);
+  show_prompt(&l);
+  if (tty)
+    write_str("\033[?2004h"); // bracketed paste on
+
+  int result = -1;
+  while (1) {
+    int key = read_key();
+
+    if (key == KEY_EOF) {
+      if (l.len > 0) {
+        /* unterminated last line: run what we have */
+        result = (int)l.len;
+      }
+      write_str("\n");
+      break;
+    }
+
+    if (key == '\n' || key == '\r') { // Enter
+      if (l.pos != l.len) {
+        l.pos = l.len;
+        move_cursor(&l);
+      }
+      write_str("\n");
+      result = (int)l.len;
+      break;
+    }
+
+    switch (key) {
+    case CTRL('d'):
+      if (l.len == 0) {
+        write_str("\n");
+        goto done;
+      }
+      /* fall through */
+    case KEY_DELETE:
+      delete_range(&l, l.pos, next_char(&l, l.pos));
+      refresh_line(&l);
+      break;
+    case 127:
+    case CTRL('h'): // Backspace
+      if (l.pos > 0) {
+        if (l.pos == l.len && l.col > 0 &&
+            (unsigned char)l.buf[l.pos - 1] >= 0x20 &&
+            (unsigned char)l.buf[l.pos - 1] < 0x7f) {
+          delete_range(&l, l.pos - 1, l.pos);
+          l.col--;
+          write_str("\b \b");
+        } else {
+          delete_range(&l, prev_char(&l, l.pos), l.pos);
+          refresh_line(&l);
+        }
+      }
+      break;
+    case KEY_LEFT:
+    case CTRL('b'):
+      l.pos = prev_char(&l, l.pos);
+      move_cursor(&l);
+      break;
+    case KEY_RIGHT:
+    case CTRL('f'):
+      l.pos = next_char(&l, l.pos);
+      move_cursor(&l);
+      break;
+    case KEY_HOME:
+    case CTRL('a'):
+      l.pos = 0;
+      move_cursor(&l);
+      break;
+    case KEY_END:
+    case CTRL('e'):
+      l.pos = l.len;
+      move_cursor(&l);
+      break;
+    case KEY_WORD_LEFT:
+    case KEY_ALT | 'b':
+      l.pos = prev_word(&l, l.pos);
+      move_cursor(&l);
+      break;
+    case KEY_WORD_RIGHT:
+    case KEY_ALT | 'f':
+      l.pos = next_word(&l, l.pos);
+      move_cursor(&l);
+      break;
+    case KEY_ALT | 'd':
+      delete_range(&l, l.pos, next_word(&l, l.pos));
+      refresh_line(&l);
+      break;
+    case KEY_ALT | 127:
+    case CTRL('w'):
+      delete_range(&l, prev_word(&l, l.pos), l.pos);
+      refresh_line(&l);
+      break;
+    case CTRL('k'):
+      delete_range(&l, l.pos, l.len);
+      refresh_line(&l);
+      break;
+    case CTRL('u'):
+      delete_range(&l, 0, l.pos);
+      refresh_line(&l);
+      break;
+    case CTRL('l'):
+      write_str("\033[H\033[2J");
+      show_prompt(&l);
+      refresh_line(&l);
+      break;
+    case KEY_UP:
+    case CTRL('p'):
+      history_move(&l, history, history_index, -1);
+      break;
+    case KEY_DOWN:
+    case CTRL('n'):
+      history_move(&l, history, history_index, 1);
+      break;
+    case KEY_PASTE_START:
+      read_paste(&l);
+      break;
+    default:
+      if (key < 0x20 || key >= 0x100) // unbound control or key
+        break;
+      {
+        char ch = (char)key;
+        if (!insert_text(&l, &ch, 1)) {
+          write_str("\a");
+        } else if (key >= 0x80 && partial_char(&l)) {
+          /* draw it once all of its bytes are in */
+        } else if (l.pos == l.len && key < 0x7f && l.col + 1 < l.cols) {
+          /* appending a plain character on the cursor's row */
+          char out[2] = {ch, '\0'};
+          write_str(out);
+          l.col++;
+        } else {
+          refresh_line(&l);
+        }
+      }
+      break;
+    }
+  }
+
+done:
+  if (tty)
+    write_str("\033[?2004l"); // bracketed paste off
+  *buf = l.buf;
+  *size = l.size;
+  return result;
+}
@@ -0,0 +1,18 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include "history.h"
+#include <stddef.h>
+
+/* Print the prompt and read one line from the terminal (which must already be
+   in raw mode) into *buf. Supports cursor movement, mid-line editing, history
+   navigation and bracketed paste. Like getline(), *buf (NULL or *size bytes
+   from malloc) is grown as the line gets longer and stays the caller's to
+   free. prompt_cols is the display width of the prompt's last line (see
+   prompt_width()); the editor positions the cursor from it. Returns the line
+   length, or -1 on EOF. */
+int editor_readline(const char *prompt, size_t prompt_cols, char **buf,
+                    size_t *size, const struct history *history,
+                    int *history_index);
+
+#endif
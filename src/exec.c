@@ -0,0 +1,42 @@
+#include "shell.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Start args in a child process. With out_fd >= 0 the child's stdout is
+   redirected there (and out_fd closed); the redirections in r, if any, are
+   applied after that. A builtin runs in the child too, so '$(alias)' or
+   '$(hist -n 1)' can be captured like any other command; pending histdb
+   records are flushed first so 'hist' in the child sees them. Returns the
+   child's pid, or -1 if fork failed. */
+pid_t spawn_command(struct mythsh *sh, char **args, struct redirs *r,
+                    int out_fd) {
+  const struct cmd_entry *e = cmdmap_get(&sh->commands, args[0]);
+  if (e && e->builtin)
+    histdb_flush(sh->histdb);
+  fflush(stdout); // don't let the child flush our buffered output again
+  pid_t pid = fork();
+  if (pid != 0) {
+    if (pid < 0)
+      perror("mythsh: fork error");
+    return pid;
+  }
+
+  signal(SIGINT, SIG_DFL); // the shell may be ignoring it while it waits
+  if (out_fd >= 0 && out_fd != STDOUT_FILENO) {
+    dup2(out_fd, STDOUT_FILENO);
+    close(out_fd);
+  }
+  if (r && !apply_redirects(r, false))
+    _exit(1);
+  if (e && e->builtin) {
+    int status = e->builtin(sh, args);
+    fflush(stdout);
+    _exit(status);
+  }
+  execvp(args[0], args);
+  fprintf(stderr, "mythsh: %s: %s\n", args[0], strerror(errno));
+  _exit(127);
+}
@@ -0,0 +1,104 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 32-bit FNV-1a, shared by the hash tables in history.c, histdb.c and
+   cmdmap.c. */
+static inline uint32_t fnv1a(const char *s, size_t n) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    hash ^= (unsigned char)s[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* Open-addressed index over an array the caller owns: each slot holds an
+   id (array position) or -1. Linear probing over a power-of-two number of
+   slots. Ids are never removed one by one, so there are no tombstones; the
+   caller rebuilds the index instead. */
+struct hash_index {
+  int *slots;
+  size_t size; // power of two, 0 until first built
+};
+
+/* Whether the entry with this id has the key being looked up. */
+typedef bool (*hash_eq_fn)(const void *ctx, int id, const void *key);
+/* The hash of the entry with this id; false leaves it out of the index. */
+typedef bool (*hash_of_fn)(const void *ctx, int id, uint32_t *hash);
+
+/* Smallest size that keeps count ids at load factor 1/2. */
+static inline size_t hash_index_size_for(size_t count) {
+  size_t size = 64;
+  while (size < count * 2)
+    size *= 2;
+  return size;
+}
+
+/* Slot holding the id whose key matches, or the empty slot where it would
+   go. */
+static inline size_t hash_index_find(const struct hash_index *t, uint32_t hash,
+                                     hash_eq_fn eq, const void *ctx,
+                                     const void *key) {
+  size_t mask = t->size - 1;
+  size_t pos = hash & mask;
+  while (t->slots[pos] != -1 && !eq(ctx, t->slots[pos], key))
+    pos = (pos + 1) & mask;
+  return pos;
+}
+
+/* Slot holding id itself, which must be in the index. */
+static inline size_t hash_index_find_id(const struct hash_index *t,
+                                        uint32_t hash, int id) {
+  size_t mask = t->size - 1;
+  size_t pos = hash & mask;
+  while (t->slots[pos] != id)
+    pos = (pos + 1) & mask;
+  return pos;
+}
+
+/* Rebuild the index with size slots from ids 0..count-1. */
+static inline bool hash_index_rebuild(struct hash_index *t, size_t size,
+                                      int count, hash_of_fn hash_of,
+                                      const void *ctx) {
+  int *slots = malloc(size * sizeof(int));
+  if (!slots)
+    return false;
+  memset(slots, 0xff, size * sizeof(int)); // all -1
+  for (int id = 0; id < count; id++) {
+    uint32_t hash;
+    if (!hash_of(ctx, id, &hash))
+      continue;
+    size_t pos = hash & (size - 1);
+    while (slots[pos] != -1)
+      pos = (pos + 1) & (size - 1);
+    slots[pos] = id;
+  }
+  free(t->slots);
+  t->slots = slots;
+  t->size = size;
+  return true;
+}
+
+/* Put id in the empty slot pos found by hash_index_find(). With count ids
+   now in the array, grow so the load factor stays at or below one half. */
+static inline void hash_index_set(struct hash_index *t, size_t pos, int id,
+                                  int count, hash_of_fn hash_of,
+                                  const void *ctx) {
+  t->slots[pos] = id;
+  if ((size_t)count * 2 > t->size)
+    hash_index_rebuild(t, t->size * 2, count, hash_of, ctx);
+}
+
+static inline void hash_index_free(struct hash_index *t) {
+  free(t->slots);
+  t->slots = NULL;
+  t->size = 0;
+}
+
+#endif
@@ -0,0 +1,684 @@
+#include "histdb.h"
+#include "hash.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HISTDB_MAGIC 0x4448594du // "MYHD"
+
+/* On-disk record: this header (host byte order) followed by cwd_len bytes of
+   working directory and cmd_len bytes of command text, no terminators. */
+struct record_header {
+  uint32_t magic;
+  uint32_t size; // header + cwd + cmd
+  int64_t start_us;
+  uint32_t duration_ms;
+  int32_t status;
+  uint32_t utime_ms;
+  uint32_t stime_ms;
+  uint32_t maxrss_kb;
+  uint16_t cwd_len;
+  uint16_t cmd_len;
+};
+
+/* A serialized record waiting for the writer thread. */
+struct pending {
+  struct pending *next;
+  size_t size;
+  char data[];
+};
+
+struct postings {
+  int *ids;
+  int len;
+  int cap;
+};
+
+/* In-memory index entry; the text stays on disk and is read back only for
+   records that are printed. */
+struct entry {
+  int64_t start_us;
+  uint32_t duration_ms;
+  int32_t status;
+  uint32_t cpu_ms;
+  int cwd_id;
+  off_t offset;
+  uint16_t cwd_len;
+  uint16_t cmd_len;
+};
+
+struct status_postings {
+  int status;
+  struct postings ids;
+};
+
+struct histdb {
+  char *path;
+  int fd;
+  pid_t owner; // the process running the writer; a forked child has none
+
+  /* writer thread */
+  pthread_t writer;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t idle;
+  struct pending *head;
+  struct pending *tail;
+  bool busy;
+  bool stop;
+
+  /* index, built from the file on the first query and then extended with
+     whatever has been appended since (by this shell or any other) */
+  off_t indexed;
+  struct entry *entries;
+  int *by_time;     // entry ids ordered by start time
+  int *by_duration; // entry ids ordered by duration
+  int count;
+  int cap;
+
+  char **cwds; // interned working directories, cwd id -> path
+  struct postings *cwd_ids;
+  int cwd_count;
+  int cwd_cap;
+  struct hash_index cwd_table; // path -> cwd id
+
+  struct status_postings *statuses;
+  int status_count;
+};
+
+/* Append one record. A single write() keeps O_APPEND records whole even
+   when several shells share the file; if it comes up short the rest is
+   written after it, and if that fails (disk full) the partial record is cut
+   off again so the next one doesn't land after torn bytes. */
+static void write_record(int fd, const char *data, size_t size) {
+  size_t done = 0;
+  off_t start = -1;
+  while (done < size) {
+    ssize_t n = write(fd, data + done, size - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    if (start < 0)
+      start = lseek(fd, 0, SEEK_CUR) - n;
+    done += n;
+  }
+  if (done == 0 || done == size || start < 0)
+    return;
+
+  /* only if nothing else was appended since, or we'd cut that off too */
+  struct stat st;
+  off_t end = lseek(fd, 0, SEEK_CUR);
+  if (end == start + (off_t)done && fstat(fd, &st) == 0 && st.st_size == end &&
+      ftruncate(fd, start) != 0)
+    perror("mythsh: hist");
+}
+
+static void *writer_main(void *arg) {
+  struct histdb *db = arg;
+
+  pthread_mutex_lock(&db->lock);
+  while (1) {
+    while (!db->head && !db->stop)
+      pthread_cond_wait(&db->wake, &db->lock);
+    if (!db->head)
+      break;
+    struct pending *batch = db->head;
+    db->head = db->tail = NULL;
+    db->busy = true;
+    pthread_mutex_unlock(&db->lock);
+
+    while (batch) {
+      struct pending *next = batch->next;
+      write_record(db->fd, batch->data, batch->size);
+      free(batch);
+      batch = next;
+    }
+
+    pthread_mutex_lock(&db->lock);
+    db->busy = false;
+    pthread_cond_broadcast(&db->idle);
+  }
+  pthread_mutex_unlock(&db->lock);
+  return NULL;
+}
+
+void histdb_flush(struct histdb *db) {
+  if (!db || getpid() != db->owner)
+    return;
+  pthread_mutex_lock(&db->lock);
+  while (db->head || db->busy)
+    pthread_cond_wait(&db->idle, &db->lock);
+  pthread_mutex_unlock(&db->lock);
+}
+
+struct histdb *histdb_open(const char *path) {
+  struct histdb *db = calloc(1, sizeof(*db));
+  if (!db)
+    return NULL;
+  db->path = strdup(path);
+  db->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  if (!db->path || db->fd < 0) {
+    free(db->path);
+    free(db);
+    return NULL;
+  }
+  pthread_mutex_init(&db->lock, NULL);
+  pthread_cond_init(&db->wake, NULL);
+  pthread_cond_init(&db->idle, NULL);
+  db->owner = getpid();
+  if (pthread_create(&db->writer, NULL, writer_main, db) != 0) {
+    close(db->fd);
+    free(db->path);
+    free(db);
+    return NULL;
+  }
+  return db;
+}
+
+void histdb_close(struct histdb *db) {
+  if (!db)
+    return;
+  /* in a forked child the writer thread and anything it held are gone;
+     just let go of the memory */
+  if (getpid() == db->owner) {
+    pthread_mutex_lock(&db->lock);
+    db->stop = true;
+    pthread_cond_signal(&db->wake);
+    pthread_mutex_unlock(&db->lock);
+    pthread_join(db->writer, NULL);
+    pthread_mutex_destroy(&db->lock);
+    pthread_cond_destroy(&db->wake);
+    pthread_cond_destroy(&db->idle);
+  }
+  close(db->fd);
+
+  for (int i = 0; i < db->cwd_count; i++) {
+    free(db->cwds[i]);
+    free(db->cwd_ids[i].ids);
+  }
+  for (int i = 0; i < db->status_count; i++)
+    free(db->statuses[i].ids.ids);
+  free(db->cwds);
+  free(db->cwd_ids);
+  hash_index_free(&db->cwd_table);
+  free(db->statuses);
+  free(db->entries);
+  free(db->by_time);
+  free(db->by_duration);
+  free(db->path);
+  free(db);
+}
+
+static uint32_t tv_ms(const struct timeval *tv) {
+  return (uint32_t)(tv->tv_sec * 1000 + tv->tv_usec / 1000);
+}
+
+void histdb_record(struct histdb *db, const char *cmd, const char *cwd,
+                   const struct timeval *start, const struct timeval *end,
+                   int status, const struct rusage *ru) {
+  size_t cwd_len = strnlen(cwd, UINT16_MAX);
+  size_t cmd_len = strnlen(cmd, UINT16_MAX);
+  size_t size = sizeof(struct record_header) + cwd_len + cmd_len;
+
+  struct pending *p = malloc(sizeof(*p) + size);
+  if (!p)
+    return;
+  p->next = NULL;
+  p->size = size;
+
+  int64_t start_us = (int64_t)start->tv_sec * 1000000 + start->tv_usec;
+  int64_t end_us = (int64_t)end->tv_sec * 1000000 + end->tv_usec;
+  struct record_header h = {
+      .magic = HISTDB_MAGIC,
+      .size = (uint32_t)size,
+      .start_us = start_us,
+      .duration_ms = (uint32_t)((end_us - start_us) / 1000),
+      .status = status,
+      .utime_ms = ru ? tv_ms(&ru->ru_utime) : 0,
+      .stime_ms = ru ? tv_ms(&ru->ru_stime) : 0,
+      .maxrss_kb = ru ? (uint32_t)ru->ru_maxrss : 0,
+      .cwd_len = (uint16_t)cwd_len,
+      .cmd_len = (uint16_t)cmd_len,
+  };
+  memcpy(p->data, &h, sizeof(h));
+  memcpy(p->data + sizeof(h), cwd, cwd_len);
+  memcpy(p->data + sizeof(h) + cwd_len, cmd, cmd_len);
+
+  pthread_mutex_lock(&db->lock);
+  if (db->tail)
+    db->tail->next = p;
+  else
+    db->head = p;
+  db->tail = p;
+  pthread_cond_signal(&db->wake);
+  pthread_mutex_unlock(&db->lock);
+}
+
+/* ---- index ---- */
+
+static bool postings_add(struct postings *p, int id) {
+  if (p->len == p->cap) {
+    int cap = p->cap ? p->cap * 2 : 16;
+    int *ids = realloc(p->ids, cap * sizeof(int));
+    if (!ids)
+      return false;
+    p->ids = ids;
+    p->cap = cap;
+  }
+  p->ids[p->len++] = id;
+  return true;
+}
+
+struct cwd_key {
+  const char *cwd;
+  size_t len; // cwd need not be terminated
+};
+
+static bool cwd_eq(const void *ctx, int id, const void *key) {
+  const struct histdb *db = ctx;
+  const struct cwd_key *k = key;
+  const char *s = db->cwds[id];
+  return strncmp(s, k->cwd, k->len) == 0 && s[k->len] == '\0';
+}
+
+static bool cwd_hash(const void *ctx, int id, uint32_t *hash) {
+  const struct histdb *db = ctx;
+  *hash = fnv1a(db->cwds[id], strlen(db->cwds[id]));
+  return true;
+}
+
+/* Table position holding cwd, or the empty position where it would go. */
+static size_t cwd_slot(const struct histdb *db, const char *cwd, size_t len) {
+  struct cwd_key key = {cwd, len};
+  return hash_index_find(&db->cwd_table, fnv1a(cwd, len), cwd_eq, db, &key);
+}
+
+static int cwd_lookup(const struct histdb *db, const char *cwd) {
+  if (db->cwd_table.size == 0)
+    return -1;
+  return db->cwd_table.slots[cwd_slot(db, cwd, strlen(cwd))];
+}
+
+static int cwd_intern(struct histdb *db, const char *cwd, size_t len) {
+  if (db->cwd_table.size == 0 &&
+      !hash_index_rebuild(&db->cwd_table, hash_index_size_for(0), 0, cwd_hash,
+                          db))
+    return -1;
+  size_t pos = cwd_slot(db, cwd, len);
+  if (db->cwd_table.slots[pos] != -1)
+    return db->cwd_table.slots[pos];
+
+  if (db->cwd_count == db->cwd_cap) {
+    int cap = db->cwd_cap ? db->cwd_cap * 2 : 16;
+    char **cwds = realloc(db->cwds, cap * sizeof(char *));
+    if (!cwds)
+      return -1;
+    db->cwds = cwds;
+    struct postings *ids = realloc(db->cwd_ids, cap * sizeof(*ids));
+    if (!ids)
+      return -1;
+    db->cwd_ids = ids;
+    db->cwd_cap = cap;
+  }
+  char *copy = strndup(cwd, len);
+  if (!copy)
+    return -1;
+  int id = db->cwd_count++;
+  db->cwds[id] = copy;
+  memset(&db->cwd_ids[id], 0, sizeof(db->cwd_ids[id]));
+  hash_index_set(&db->cwd_table, pos, id, db->cwd_count, cwd_hash, db);
+  return id;
+}
+
+static struct postings *status_ids(struct histdb *db, int status, bool add) {
+  for (int i = 0; i < db->status_count; i++) {
+    if (db->statuses[i].status == status)
+      return &db->statuses[i].ids;
+  }
+  if (!add)
+    return NULL;
+  struct status_postings *s =
+      realloc(db->statuses, (db->status_count + 1) * sizeof(*s));
+  if (!s)
+    return NULL;
+  db->statuses = s;
+  s = &db->statuses[db->status_count++];
+  s->status = status;
+  memset(&s->ids, 0, sizeof(s->ids));
+  return &s->ids;
+}
+
+/* First position in ids whose key is >= value (keys ascending). */
+static int lower_bound(const struct histdb *db, const int *ids, int n,
+                       int64_t value, bool by_time) {
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    const struct entry *e = &db->entries[ids[mid]];
+    int64_t key = by_time ? e->start_us : (int64_t)e->duration_ms;
+    if (key < value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Insert id into a sorted id array. */
+static void sorted_insert(struct histdb *db, int *ids, int n, int id,
+                          bool by_time) {
+  const struct entry *e = &db->entries[id];
+  int64_t key = by_time ? e->start_us : (int64_t)e->duration_ms;
+  int pos = lower_bound(db, ids, n, key + 1, by_time);
+  memmove(&ids[pos + 1], &ids[pos], (n - pos) * sizeof(int));
+  ids[pos] = id;
+}
+
+struct keyed_id {
+  int64_t key;
+  int id;
+};
+
+static int cmp_keyed(const void *a, const void *b) {
+  const struct keyed_id *x = a, *y = b;
+  if (x->key != y->key)
+    return (x->key > y->key) - (x->key < y->key);
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+/* ids[0..from) is sorted and ids[from..count) holds the entries indexed
+   since. Sort those once and merge them in from the back, so indexing n
+   records costs O(n log n) rather than a memmove each. Without scratch
+   space, fall back to inserting them one at a time. */
+static void merge_batch(struct histdb *db, int *ids, int from, bool by_time,
+                        struct keyed_id *batch) {
+  int n = db->count - from;
+  if (!batch) {
+    for (int i = from; i < db->count; i++)
+      sorted_insert(db, ids, i, ids[i], by_time);
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    const struct entry *e = &db->entries[ids[from + i]];
+    batch[i].key = by_time ? e->start_us : (int64_t)e->duration_ms;
+    batch[i].id = ids[from + i];
+  }
+  qsort(batch, n, sizeof(*batch), cmp_keyed);
+
+  int i = from - 1, j = n - 1, k = db->count - 1;
+  while (j >= 0) {
+    if (i >= 0) {
+      const struct entry *e = &db->entries[ids[i]];
+      int64_t key = by_time ? e->start_us : (int64_t)e->duration_ms;
+      if (key > batch[j].key) {
+        ids[k--] = ids[i--];
+        continue;
+      }
+    }
+    ids[k--] = batch[j--].id;
+  }
+}
+
+static bool index_add(struct histdb *db, const struct record_header *h,
+                      const char *cwd, off_t offset) {
+  if (db->count == db->cap) {
+    int cap = db->cap ? db->cap * 2 : 256;
+    struct entry *entries = realloc(db->entries, cap * sizeof(*entries));
+    if (!entries)
+      return false;
+    db->entries = entries;
+    int *by_time = realloc(db->by_time, cap * sizeof(int));
+    if (!by_time)
+      return false;
+    db->by_time = by_time;
+    int *by_duration = realloc(db->by_duration, cap * sizeof(int));
+    if (!by_duration)
+      return false;
+    db->by_duration = by_duration;
+    db->cap = cap;
+  }
+
+  int cwd_id = cwd_intern(db, cwd, h->cwd_len);
+  struct postings *st = status_ids(db, h->status, true);
+  if (cwd_id < 0 || !st)
+    return false;
+
+  int id = db->count;
+  db->entries[id] = (struct entry){
+      .start_us = h->start_us,
+      .duration_ms = h->duration_ms,
+      .status = h->status,
+      .cpu_ms = h->utime_ms + h->stime_ms,
+      .cwd_id = cwd_id,
+      .offset = offset,
+      .cwd_len = h->cwd_len,
+      .cmd_len = h->cmd_len,
+  };
+  if (!postings_add(&db->cwd_ids[cwd_id], id) || !postings_add(st, id))
+    return false;
+  /* appended unsorted; catch_up() merges the whole batch at once */
+  db->by_time[id] = id;
+  db->by_duration[id] = id;
+  db->count++;
+  return true;
+}
+
+/* Index the records appended since the last call. */
+static bool valid_header(const struct record_header *h) {
+  return h->magic == HISTDB_MAGIC &&
+         h->size == sizeof(*h) + h->cwd_len + h->cmd_len;
+}
+
+/* Offset of the first plausible record header in buf[from..n), or, if there
+   is none, of the last bytes too short to hold one (they may be the start
+   of a record still being written). */
+static size_t resync(const char *buf, size_t from, size_t n) {
+  size_t pos = from;
+  for (; n - pos >= sizeof(struct record_header); pos++) {
+    struct record_header h;
+    memcpy(&h, buf + pos, sizeof(h));
+    if (valid_header(&h))
+      break;
+  }
+  return pos;
+}
+
+static void catch_up(struct histdb *db) {
+  int fd = open(db->path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= db->indexed) {
+    close(fd);
+    return;
+  }
+
+  size_t len = (size_t)(st.st_size - db->indexed);
+  char *buf = malloc(len);
+  ssize_t n = buf ? pread(fd, buf, len, db->indexed) : -1;
+  close(fd);
+  if (n <= 0) {
+    free(buf);
+    return;
+  }
+
+  int from = db->count;
+  size_t pos = 0;
+  while ((size_t)n - pos >= sizeof(struct record_header)) {
+    struct record_header h;
+    memcpy(&h, buf + pos, sizeof(h));
+    if (!valid_header(&h)) {
+      /* skip to the next record so one torn write doesn't hide the rest */
+      size_t next = resync(buf, pos + 1, (size_t)n);
+      fprintf(stderr, "mythsh: hist: %s: skipped %zu corrupt bytes at offset "
+              "%lld\n", db->path, next - pos, (long long)(db->indexed + pos));
+      pos = next;
+      continue;
+    }
+    if ((size_t)n - pos < h.size)
+      break; // partially written; pick it up next time
+    if (!index_add(db, &h, buf + pos + sizeof(h), db->indexed + pos))
+      break;
+    pos += h.size;
+  }
+  free(buf);
+
+  if (db->count > from) {
+    struct keyed_id *batch = malloc((db->count - from) * sizeof(*batch));
+    merge_batch(db, db->by_time, from, true, batch);
+    merge_batch(db, db->by_duration, from, false, batch);
+    free(batch);
+  }
+  db->indexed += pos;
+}
+
+static bool matches(const struct entry *e, const struct histdb_query *q,
+                    int cwd_id) {
+  if (q->cwd && e->cwd_id != cwd_id)
+    return false;
+  if (q->match_status && e->status != q->status)
+    return false;
+  if (q->failed && e->status == 0)
+    return false;
+  if (q->since && e->start_us < q->since * 1000000)
+    return false;
+  if (q->until && e->start_us >= q->until * 1000000)
+    return false;
+  if (e->duration_ms < q->min_duration_ms)
+    return false;
+  return true;
+}
+
+static void print_entry(const struct entry *e, int fd, FILE *out) {
+  size_t len = (size_t)e->cwd_len + e->cmd_len;
+  char *text = malloc(len + 1);
+  if (!text)
+    return;
+  if (pread(fd, text, len, e->offset + sizeof(struct record_header)) !=
+      (ssize_t)len) {
+    free(text);
+    return;
+  }
+
+  char when[32];
+  time_t secs = (time_t)(e->start_us / 1000000);
+  struct tm tm;
+  localtime_r(&secs, &tm);
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+  fprintf(out, "%s %5u.%03us cpu %3u.%03us exit %-3d %.*s  %.*s\n", when,
+          e->duration_ms / 1000, e->duration_ms % 1000, e->cpu_ms / 1000,
+          e->cpu_ms % 1000, e->status, (int)e->cwd_len, text,
+          (int)e->cmd_len, text + e->cwd_len);
+  free(text);
+}
+
+static int cmp_ids(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+int histdb_query(struct histdb *db, const struct histdb_query *q, FILE *out) {
+  histdb_flush(db);
+  catch_up(db);
+  if (db->count == 0)
+    return 0;
+
+  /* Start from whichever index narrows things down most, then check the
+     remaining filters on just those entries. */
+  const int *cand = NULL;
+  int ncand = db->count;
+  int cwd_id = -1;
+  int *failed = NULL; // union of the non-zero status postings
+
+  if (q->cwd) {
+    cwd_id = cwd_lookup(db, q->cwd);
+    if (cwd_id < 0)
+      return 0;
+    cand = db->cwd_ids[cwd_id].ids;
+    ncand = db->cwd_ids[cwd_id].len;
+  }
+  if (q->match_status) {
+    struct postings *p = status_ids(db, q->status, false);
+    if (!p)
+      return 0;
+    if (p->len < ncand) {
+      cand = p->ids;
+      ncand = p->len;
+    }
+  }
+  if (q->failed) {
+    int n = 0;
+    for (int s = 0; s < db->status_count; s++) {
+      if (db->statuses[s].status != 0)
+        n += db->statuses[s].ids.len;
+    }
+    if (n < ncand && (failed = malloc((n > 0 ? n : 1) * sizeof(int)))) {
+      n = 0;
+      for (int s = 0; s < db->status_count; s++) {
+        const struct postings *p = &db->statuses[s].ids;
+        if (db->statuses[s].status != 0) {
+          memcpy(failed + n, p->ids, p->len * sizeof(int));
+          n += p->len;
+        }
+      }
+      cand = failed;
+      ncand = n;
+    }
+  }
+  if (q->since || q->until) {
+    int lo = q->since ? lower_bound(db, db->by_time, db->count,
+                                    q->since * 1000000, true)
+                      : 0;
+    int hi = q->until ? lower_bound(db, db->by_time, db->count,
+                                    q->until * 1000000, true)
+                      : db->count;
+    if (hi < lo)
+      hi = lo;
+    if (hi - lo < ncand) {
+      cand = db->by_time + lo;
+      ncand = hi - lo;
+    }
+  }
+  if (q->min_duration_ms) {
+    int lo = lower_bound(db, db->by_duration, db->count, q->min_duration_ms,
+                         false);
+    if (db->count - lo < ncand) {
+      cand = db->by_duration + lo;
+      ncand = db->count - lo;
+    }
+  }
+
+  int *hits = malloc((ncand > 0 ? ncand : 1) * sizeof(int));
+  if (!hits) {
+    free(failed);
+    return 0;
+  }
+  int nhits = 0;
+  for (int i = 0; i < ncand; i++) {
+    int id = cand ? cand[i] : i;
+    if (matches(&db->entries[id], q, cwd_id))
+      hits[nhits++] = id;
+  }
+  free(failed);
+  /* ids are file order, which is the order commands finished in */
+  qsort(hits, nhits, sizeof(int), cmp_ids);
+
+  int first = (q->limit > 0 && nhits > q->limit) ? nhits - q->limit : 0;
+  int fd = open(db->path, O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    for (int i = first; i < nhits; i++)
+      print_entry(&db->entries[hits[i]], fd, out);
+    close(fd);
+  }
+  free(hits);
+  return fd >= 0 ? nhits - first : 0;
+}
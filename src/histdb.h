@@ -0,0 +1,45 @@
+#ifndef HISTDB_H
+#define HISTDB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#define HISTDB_FILE ".mythsh_histdb"
+
+/* Optional structured history: one binary record per external command
+   (start time, cwd, duration, exit status, rusage), appended to a log file by
+   a background thread so the prompt never waits on the disk. */
+struct histdb;
+
+/* Filters for histdb_query(). Zero/NULL fields match everything. */
+struct histdb_query {
+  const char *cwd;
+  int64_t since; // unix seconds
+  int64_t until; // unix seconds
+  bool match_status;
+  int status;
+  bool failed; // any non-zero status
+  uint32_t min_duration_ms;
+  int limit; // most recent matches to print
+};
+
+struct histdb *histdb_open(const char *path);
+void histdb_close(struct histdb *db);
+
+/* Wait until everything queued so far is on disk. Does nothing in a forked
+   child, which has no writer thread: flush before forking instead. */
+void histdb_flush(struct histdb *db);
+
+/* Queue a record for a finished command. status is the exit code, or
+   128 + signal number if the command was killed. */
+void histdb_record(struct histdb *db, const char *cmd, const char *cwd,
+                   const struct timeval *start, const struct timeval *end,
+                   int status, const struct rusage *ru);
+
+/* Print matching records, oldest first. Returns the number printed. */
+int histdb_query(struct histdb *db, const struct histdb_query *q, FILE *out);
+
+#endif
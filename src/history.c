@@ -0,0 +1,249 @@
+#include "history.h"
+#include "hash.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* When the history is full, drop this many of the oldest entries at once so
+   the arena is compacted rarely rather than on every command. */
+#define HISTORY_EVICT (MAX_HISTORY / 4)
+
+/* Marks an index slot whose entry was re-added later during a load. */
+#define DEAD_SLOT UINT32_MAX
+
+void history_init(struct history *h) { memset(h, 0, sizeof(*h)); }
+
+void history_free(struct history *h) {
+  free(h->arena);
+  free(h->offsets);
+  free(h->hashes);
+  hash_index_free(&h->table);
+  memset(h, 0, sizeof(*h));
+}
+
+const char *history_get(const struct history *h, int index) {
+  if (index < 0 || index >= h->count)
+    return NULL;
+  return h->arena + h->offsets[index];
+}
+
+struct line_key {
+  const char *line;
+  uint32_t hash;
+};
+
+static bool entry_eq(const void *ctx, int e, const void *key) {
+  const struct history *h = ctx;
+  const struct line_key *k = key;
+  return h->hashes[e] == k->hash &&
+         strcmp(h->arena + h->offsets[e], k->line) == 0;
+}
+
+static bool entry_hash(const void *ctx, int e, uint32_t *hash) {
+  const struct history *h = ctx;
+  *hash = h->hashes[e];
+  return h->offsets[e] != DEAD_SLOT;
+}
+
+/* Table position holding line, or the empty position where it would go. */
+static size_t table_slot(const struct history *h, const char *line,
+                         uint32_t hash) {
+  struct line_key key = {line, hash};
+  return hash_index_find(&h->table, hash, entry_eq, h, &key);
+}
+
+/* Rebuild the hash table for the live entries. */
+static bool reindex(struct history *h) {
+  return hash_index_rebuild(&h->table, hash_index_size_for(h->count),
+                            h->count, entry_hash, h);
+}
+
+/* Drop the n oldest entries and compact the arena. Entries are not in arena
+   order once some have been moved to the front, so copy into a new one. */
+static void evict_oldest(struct history *h, int n) {
+  if (n > h->count)
+    n = h->count;
+  char *arena = malloc(h->arena_cap);
+  if (!arena)
+    return;
+  size_t len = 0;
+  for (int i = n; i < h->count; i++) {
+    const char *s = h->arena + h->offsets[i];
+    size_t size = strlen(s) + 1;
+    memcpy(arena + len, s, size);
+    h->offsets[i - n] = (uint32_t)len;
+    h->hashes[i - n] = h->hashes[i];
+    len += size;
+  }
+  free(h->arena);
+  h->arena = arena;
+  h->arena_len = len;
+  h->count -= n;
+  reindex(h);
+}
+
+static bool reserve_slot(struct history *h) {
+  if (h->count < h->cap)
+    return true;
+  int cap = h->cap ? h->cap * 2 : 64;
+  uint32_t *offsets = realloc(h->offsets, cap * sizeof(uint32_t));
+  if (!offsets)
+    return false;
+  h->offsets = offsets;
+  uint32_t *hashes = realloc(h->hashes, cap * sizeof(uint32_t));
+  if (!hashes)
+    return false;
+  h->hashes = hashes;
+  h->cap = cap;
+  return true;
+}
+
+static bool reserve_text(struct history *h, size_t len) {
+  if (h->arena_len + len + 1 <= h->arena_cap)
+    return true;
+  size_t cap = h->arena_cap ? h->arena_cap * 2 : 4096;
+  while (cap < h->arena_len + len + 1)
+    cap *= 2;
+  if (cap > UINT32_MAX)
+    return false;
+  char *arena = realloc(h->arena, cap);
+  if (!arena)
+    return false;
+  h->arena = arena;
+  h->arena_cap = cap;
+  return true;
+}
+
+/* Drop the dead slots left behind by history_load(). */
+static void compact(struct history *h) {
+  int n = 0;
+  for (int i = 0; i < h->count; i++) {
+    if (h->offsets[i] == DEAD_SLOT)
+      continue;
+    h->offsets[n] = h->offsets[i];
+    h->hashes[n] = h->hashes[i];
+    n++;
+  }
+  h->count = n;
+  h->dead = 0;
+  reindex(h);
+}
+
+/* Move the entry at table position pos to the newest index. Only the entries
+   after it shift, so re-running a recent command is cheap. */
+static void move_to_newest(struct history *h, size_t pos) {
+  int e = h->table.slots[pos];
+  int last = h->count - 1;
+  if (e == last)
+    return;
+
+  uint32_t offset = h->offsets[e];
+  uint32_t hash = h->hashes[e];
+  memmove(&h->offsets[e], &h->offsets[e + 1], (last - e) * sizeof(uint32_t));
+  memmove(&h->hashes[e], &h->hashes[e + 1], (last - e) * sizeof(uint32_t));
+  h->offsets[last] = offset;
+  h->hashes[last] = hash;
+
+  for (int i = e; i < last; i++)
+    h->table.slots[hash_index_find_id(&h->table, h->hashes[i], i + 1)] = i;
+  h->table.slots[pos] = last;
+}
+
+/* Append line as the newest entry. With lazy set, a repeat leaves a dead
+   slot behind instead of shifting the index; compact() cleans those up. */
+static void add_entry(struct history *h, const char *line, bool lazy) {
+  size_t len = strlen(line);
+  uint32_t hash = fnv1a(line, len);
+  if (len == 0)
+    return;
+  if (h->table.size == 0 && !reindex(h))
+    return;
+
+  size_t pos = table_slot(h, line, hash);
+  int e = h->table.slots[pos];
+  if (e != -1 && !lazy) {
+    move_to_newest(h, pos);
+    return;
+  }
+
+  if (h->count >= MAX_HISTORY) {
+    if (h->dead > 0)
+      compact(h);
+    if (h->count >= MAX_HISTORY)
+      evict_oldest(h, HISTORY_EVICT);
+    pos = table_slot(h, line, hash);
+    e = h->table.slots[pos];
+  }
+  if (!reserve_slot(h))
+    return;
+
+  uint32_t offset;
+  if (e != -1) {
+    /* lazy repeat: share the stored text */
+    offset = h->offsets[e];
+    h->offsets[e] = DEAD_SLOT;
+    h->dead++;
+  } else {
+    if (!reserve_text(h, len))
+      return;
+    offset = (uint32_t)h->arena_len;
+    memcpy(h->arena + h->arena_len, line, len + 1);
+    h->arena_len += len + 1;
+  }
+  h->offsets[h->count] = offset;
+  h->hashes[h->count] = hash;
+  int id = h->count++;
+  hash_index_set(&h->table, pos, id, h->count, entry_hash, h);
+}
+
+/* Add a command as the newest entry. A command already in the history is
+   moved to the newest position instead of being stored again. */
+void history_add(struct history *h, const char *line) {
+  add_entry(h, line, false);
+}
+
+/* Index of the newest entry older than 'before' that contains needle, or -1. */
+int history_find(const struct history *h, const char *needle, int before) {
+  if (before > h->count)
+    before = h->count;
+  for (int i = before - 1; i >= 0; i--) {
+    if (strstr(h->arena + h->offsets[i], needle) != NULL)
+      return i;
+  }
+  return -1;
+}
+
+void history_load(struct history *h, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return;
+
+  char line[1024];
+  while (fgets(line, sizeof(line), file)) {
+    line[strcspn(line, "\n")] = '\0'; // Remove newline
+    add_entry(h, line, true);
+  }
+  fclose(file);
+  if (h->dead > 0)
+    compact(h);
+
+  /* the arena only grows by appending from here on; give back the slack */
+  if (h->arena_len > 0 && h->arena_len < h->arena_cap) {
+    char *arena = realloc(h->arena, h->arena_len);
+    if (arena) {
+      h->arena = arena;
+      h->arena_cap = h->arena_len;
+    }
+  }
+}
+
+void history_save(const struct history *h, const char *path) {
+  FILE *file = fopen(path, "w");
+  if (!file)
+    return;
+  for (int i = 0; i < h->count; i++) {
+    fprintf(file, "%s\n", h->arena + h->offsets[i]);
+  }
+  fclose(file);
+}
@@ -0,0 +1,38 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "hash.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Most entries kept; beyond this the oldest are dropped. */
+#define MAX_HISTORY 100000
+
+/* Command history. Entries live back to back in one byte arena and are
+   indexed by offset, oldest first. Every command is stored once: adding one
+   that is already present moves it to the newest position. */
+struct history {
+  char *arena; // NUL-terminated entries
+  size_t arena_len;
+  size_t arena_cap;
+
+  uint32_t *offsets; // offsets[i] is where entry i starts in arena
+  uint32_t *hashes;  // hashes[i] is the hash of entry i
+  int count;
+  int cap;
+  int dead; // slots awaiting compaction; only non-zero inside history_load()
+
+  struct hash_index table; // entry text -> entry index
+};
+
+void history_init(struct history *h);
+void history_free(struct history *h);
+
+void history_add(struct history *h, const char *line);
+const char *history_get(const struct history *h, int index);
+int history_find(const struct history *h, const char *needle, int before);
+
+void history_load(struct history *h, const char *path);
+void history_save(const struct history *h, const char *path);
+
+#endif
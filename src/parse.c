@@ -0,0 +1,134 @@
+#include "shell.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Simple tokenization on whitespace. Note: this does NOT support quoted args.
+   If you want quoting (e.g. "some arg with spaces") you'll need a tokenizer
+   that recognizes quotes. Returns false, with args left empty, if there are
+   more than MAX_ARGS - 1 words. */
+bool parse_input(char *input, char **args) {
+  char *token;
+  int i = 0;
+
+  token = strtok(input, " \t\n");
+  while (token != NULL) {
+    if (i == MAX_ARGS - 1) {
+      args[0] = NULL;
+      return false;
+    }
+    args[i++] = token;
+    token = strtok(NULL, " \t\n");
+  }
+  args[i] = NULL;
+  return true;
+}
+
+/* An alias whose value starts with another alias is expanded again, up to
+   this many times. */
+#define MAX_ALIAS_DEPTH 16
+
+/* Replace the first word of input with its alias value, repeatedly. Each
+   alias is expanded at most once per line, so 'alias ls=ls -F' and alias
+   loops terminate. Returns input itself if it starts with no alias, else
+   the expansion, kept in *expanded; NULL if out of memory. */
+static const char *expand_aliases(const struct mythsh *sh, const char *input,
+                                  struct strbuf *expanded) {
+  const struct cmd_entry *seen[MAX_ALIAS_DEPTH];
+  int depth = 0;
+  struct strbuf next = {0};
+
+  while (depth < MAX_ALIAS_DEPTH) {
+    const char *word = input + strspn(input, " \t\n");
+    size_t len = strcspn(word, " \t\n");
+    if (len == 0 || len >= MAX_INPUTS)
+      goto out;
+
+    char name[MAX_INPUTS];
+    memcpy(name, word, len);
+    name[len] = '\0';
+    const struct cmd_entry *e = cmdmap_get(&sh->commands, name);
+    if (!e || !e->alias)
+      goto out;
+    for (int k = 0; k < depth; k++) {
+      if (seen[k] == e)
+        goto out;
+    }
+    seen[depth++] = e;
+
+    /* build into next, since input may point into *expanded */
+    next.len = 0;
+    if (!strbuf_append(&next, e->alias, strlen(e->alias)) ||
+        !strbuf_append(&next, word + len, strlen(word + len))) {
+      strbuf_free(&next);
+      return NULL;
+    }
+    struct strbuf prev = *expanded;
+    *expanded = next;
+    next = prev;
+    input = expanded->data;
+  }
+out:
+  strbuf_free(&next);
+  return input;
+}
+
+/* Put a space before every unescaped < or > that starts a redirection in
+   the middle of a word, so 'echo hi>out' and 'make 2>&1>log' split into the
+   command's words and operators parse_redirects() recognizes. Digits that
+   make up a whole word stay attached as the fd ('2>err'); \< and \> (which
+   is also how $(...) output arrives) are left alone. */
+static bool split_operators(struct strbuf *line) {
+  if (strpbrk(line->data, "<>") == NULL)
+    return true;
+
+  struct strbuf out = {0};
+  bool in_operator = false;
+  for (const char *p = line->data; *p; p++) {
+    if (p[0] == '\\' && (p[1] == '<' || p[1] == '>')) {
+      if (!strbuf_append(&out, p, 2))
+        goto fail;
+      p++;
+      in_operator = false;
+      continue;
+    }
+    if ((*p == '<' || *p == '>') && !in_operator) {
+      size_t word = out.len;
+      while (word > 0 && isdigit((unsigned char)out.data[word - 1]))
+        word--;
+      if (word > 0 && !isspace((unsigned char)out.data[word - 1]) &&
+          !strbuf_append(&out, " ", 1))
+        goto fail;
+    }
+    in_operator = *p == '<' || *p == '>';
+    if (!strbuf_append(&out, p, 1))
+      goto fail;
+  }
+  strbuf_free(line);
+  *line = out;
+  return true;
+
+fail:
+  strbuf_free(&out);
+  return false;
+}
+
+/* Parse one command line: expand aliases, then $(...), then split it into
+   args, with redirection operators as words of their own. The args point into store, which the caller keeps until it is done
+   with them (and frees with strbuf_free()). */
+void parse_command(struct mythsh *sh, const char *input, struct strbuf *store,
+                   char **args) {
+  struct strbuf expanded = {0};
+  const char *line = expand_aliases(sh, input, &expanded);
+  bool ok = line && expand_substitutions(sh, line, store) &&
+            store->data != NULL && split_operators(store);
+  strbuf_free(&expanded);
+  if (!ok) {
+    args[0] = NULL;
+    return;
+  }
+  if (!parse_input(store->data, args))
+    fprintf(stderr, "mythsh: too many arguments (at most %d)\n",
+            MAX_ARGS - 1);
+}
@@ -0,0 +1,210 @@
+#include "shell.h"
+#include "width.h"
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h> // for MAXHOSTNAMELEN fallback
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef HOST_NAME_MAX
+#ifdef MAXHOSTNAMELEN
+#define HOST_NAME_MAX MAXHOSTNAMELEN
+#else
+#define HOST_NAME_MAX 64
+#endif
+#endif
+
+static bool is_git_repo(void) {
+  struct stat st;
+  return (stat(".git", &st) == 0 && S_ISDIR(st.st_mode));
+}
+
+static void get_git_branch(char *branch, size_t size) {
+  FILE *fp = popen("git rev-parse --abbrev-ref HEAD 2>/dev/null", "r");
+  if (!fp) {
+    branch[0] = '\0';
+    return;
+  }
+  if (fgets(branch, size, fp) != NULL)
+    branch[strcspn(branch, "\n")] = '\0'; // strip newline
+  else
+    branch[0] = '\0';
+  pclose(fp);
+}
+
+static bool is_utf8_locale(void) {
+  const char *vars[] = {getenv("LC_ALL"), getenv("LC_CTYPE"), getenv("LANG")};
+  for (size_t i = 0; i < sizeof(vars) / sizeof(vars[0]); i++) {
+    if (vars[i] && (strstr(vars[i], "UTF-8") || strstr(vars[i], "utf8"))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Append fmt to out at j, with %v replaced by value and {a|b} resolved for
+   the locale. Returns the new length. */
+static int render_segment(char *out, int j, const char *fmt, const char *value,
+                          bool use_utf8) {
+  int alt = 0; // 0: outside {}, 1: UTF-8 branch, 2: fallback branch
+  for (const char *p = fmt ? fmt : ""; *p && j < MAX_PROMPT - 1; p++) {
+    if (*p == '{' && alt == 0) {
+      alt = 1;
+      continue;
+    }
+    if (*p == '|' && alt == 1) {
+      alt = 2;
+      continue;
+    }
+    if (*p == '}' && alt != 0) {
+      alt = 0;
+      continue;
+    }
+    if (alt == 1 && !use_utf8)
+      continue;
+    if (alt == 2 && use_utf8)
+      continue;
+    if (p[0] == '%' && p[1] == 'v') {
+      for (const char *v = value; *v && j < MAX_PROMPT - 1; v++)
+        out[j++] = *v;
+      p++;
+    } else {
+      out[j++] = *p;
+    }
+  }
+  return j;
+}
+
+/* Columns taken by the last line of a prompt, which is where the input
+   starts. Escape sequences take none and wide glyphs take two. */
+size_t prompt_width(const char *prompt) {
+  const char *last = strrchr(prompt, '\n');
+  last = last ? last + 1 : prompt;
+  return display_width(last, strlen(last));
+}
+
+/* Build prompt from a template with %u (user), %h (hostname), %d (cwd) and
+   %g (git branch), each drawn with the current theme's segment format, and
+   $(cmd) replaced by the command's (cached) output. Returns the prompt's
+   prompt_width(), measured while the result is still hot. */
+size_t build_prompt(struct mythsh *sh, const char *input_template,
+                    char *output) {
+  bool use_utf8 = is_utf8_locale();
+  const struct theme *theme = &sh->themes[sh->theme];
+  char temp[MAX_PROMPT];
+  int i = 0, j = 0;
+
+  while (input_template[i] != '\0' && j < MAX_PROMPT - 1) {
+    const char *value;
+    size_t n = prompt_substitution(sh, &input_template[i], &value);
+    if (n > 0) {
+      for (; *value && j < MAX_PROMPT - 1; value++)
+        temp[j++] = *value;
+      i += n;
+      continue;
+    }
+    if (input_template[i] == '%' && input_template[i + 1] != '\0') {
+      i++;
+      if (input_template[i] == 'u') {
+        struct passwd *pw = getpwuid(getuid());
+        const char *name = (pw && pw->pw_name) ? pw->pw_name : "unknown";
+        j = render_segment(temp, j, theme->seg[SEG_USER], name, use_utf8);
+      } else if (input_template[i] == 'h') {
+        char hostname[HOST_NAME_MAX];
+        if (gethostname(hostname, sizeof(hostname)) == 0)
+          hostname[sizeof(hostname) - 1] = '\0';
+        else
+          strcpy(hostname, "host");
+        j = render_segment(temp, j, theme->seg[SEG_HOST], hostname, use_utf8);
+      } else if (input_template[i] == 'd') {
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) == NULL)
+          strcpy(cwd, ".");
+        j = render_segment(temp, j, theme->seg[SEG_DIR], cwd, use_utf8);
+      } else if (input_template[i] == 'g') {
+        char branch[64] = "";
+        if (is_git_repo()) {
+          get_git_branch(branch, sizeof(branch));
+          j = render_segment(temp, j, theme->seg[SEG_GIT],
+                             branch[0] ? branch : "git", use_utf8);
+        } else {
+          j = render_segment(temp, j, theme->seg[SEG_NOGIT], "", use_utf8);
+        }
+      } else {
+        /* Unknown directive: emit %<char> literally */
+        if (j < MAX_PROMPT - 2) {
+          temp[j++] = '%';
+          temp[j++] = input_template[i];
+        } else if (j < MAX_PROMPT - 1) {
+          temp[j++] = '%';
+        }
+      }
+    } else {
+      temp[j++] = input_template[i];
+    }
+    i++;
+  }
+  /* Ensure prompt ends with a reset so colors don't bleed even if truncated */
+  if (j < MAX_PROMPT - 5) {
+    int written = snprintf(&temp[j], MAX_PROMPT - j, "\033[0m");
+    if (written > 0)
+      j += (written < (MAX_PROMPT - j) ? written : (MAX_PROMPT - j - 1));
+  }
+  temp[j] = '\0';
+  /* Ensure output is null-terminated and fits */
+  strncpy(output, temp, MAX_PROMPT - 1);
+  output[MAX_PROMPT - 1] = '\0';
+  return prompt_width(output);
+}
+
+/* Expand the escapes usable in prompts, moods and theme formats from the rc
+   file: \n (newline), \e and \033 (ESC), \uXXXX (a code point, e.g. a Nerd
+   Font glyph) and \\. Works in-place; other backslashes are kept. */
+void unescape_prompt(char *str, size_t size) {
+  char buffer[MAX_PROMPT];
+  size_t i = 0, j = 0;
+  (void)size; // size not used now; we limit by MAX_PROMPT
+  while (str[i] != '\0' && j < MAX_PROMPT - 4) {
+    if (str[i] != '\\') {
+      buffer[j++] = str[i++];
+    } else if (str[i + 1] == 'n') {
+      buffer[j++] = '\n';
+      i += 2;
+    } else if (str[i + 1] == 'e') {
+      buffer[j++] = '\033';
+      i += 2;
+    } else if (strncmp(&str[i + 1], "033", 3) == 0) {
+      buffer[j++] = '\033';
+      i += 4;
+    } else if (str[i + 1] == '\\') {
+      buffer[j++] = '\\';
+      i += 2;
+    } else if (str[i + 1] == 'u' &&
+               strspn(&str[i + 2], "0123456789abcdefABCDEF") >= 4) {
+      char hex[5];
+      memcpy(hex, &str[i + 2], 4);
+      hex[4] = '\0';
+      unsigned long cp = strtoul(hex, NULL, 16);
+      /* UTF-8 encode (4 hex digits never need more than 3 bytes) */
+      if (cp < 0x80) {
+        buffer[j++] = (char)cp;
+      } else if (cp < 0x800) {
+        buffer[j++] = (char)(0xc0 | (cp >> 6));
+        buffer[j++] = (char)(0x80 | (cp & 0x3f));
+      } else {
+        buffer[j++] = (char)(0xe0 | (cp >> 12));
+        buffer[j++] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        buffer[j++] = (char)(0x80 | (cp & 0x3f));
+      }
+      i += 6;
+    } else {
+      buffer[j++] = str[i++];
+    }
+  }
+  buffer[j] = '\0';
+  /* Copy back safely */
+  strncpy(str, buffer, MAX_PROMPT - 1);
+  str[MAX_PROMPT - 1] = '\0';
+}
@@ -0,0 +1,257 @@
+#define _GNU_SOURCE // memfd_create()
+#include "shell.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Fds the shell keeps its own copies of stdin/stdout/stderr at while a
+   redirected builtin runs, out of the way of anything a user would name. */
+#define SAVED_FD_MIN 10
+
+/* Recognize a redirection operator at the start of tok: [n]> [n]>> [n]>&m
+   [n]< <<< <<. Fills in kind and fd and returns the length of the operator,
+   or 0 if tok is an ordinary word. */
+static size_t scan_operator(const char *tok, struct redir *r) {
+  const char *p = tok;
+  int fd = -1;
+  if (isdigit((unsigned char)*p)) {
+    fd = 0;
+    while (isdigit((unsigned char)*p))
+      fd = fd * 10 + (*p++ - '0');
+  }
+  if (strncmp(p, "<<<", 3) == 0 && fd < 0) {
+    r->kind = REDIR_HERESTRING;
+    p += 3;
+  } else if (strncmp(p, "<<", 2) == 0 && fd < 0) {
+    r->kind = REDIR_HEREDOC;
+    p += 2;
+  } else if (*p == '<') {
+    r->kind = REDIR_IN;
+    p++;
+  } else if (strncmp(p, ">>", 2) == 0) {
+    r->kind = REDIR_APPEND;
+    p += 2;
+  } else if (strncmp(p, ">&", 2) == 0) {
+    r->kind = REDIR_DUP;
+    p += 2;
+  } else if (*p == '>') {
+    r->kind = REDIR_OUT;
+    p++;
+  } else {
+    return 0;
+  }
+  if (fd < 0)
+    fd = (r->kind == REDIR_IN || r->kind == REDIR_HERESTRING ||
+          r->kind == REDIR_HEREDOC)
+             ? STDIN_FILENO
+             : STDOUT_FILENO;
+  r->fd = fd;
+  return p - tok;
+}
+
+/* Drop the backslash from every \< and \> in word, in place. */
+static void unescape_word(char *word) {
+  char *out = word;
+  for (char *p = word; *p; p++) {
+    if (p[0] == '\\' && (p[1] == '<' || p[1] == '>'))
+      p++;
+    *out++ = *p;
+  }
+  *out = '\0';
+}
+
+/* Move the redirections out of args into r, leaving only the command's own
+   arguments. Operators may be separate words or attached to their target
+   (">out.txt", "2>&1"). A word starting with \> or \< is not an operator;
+   that backslash, and any before a later < or >, is removed, so 'todo add
+   a \> b' keeps its '>'. Returns false, after saying why, on a malformed
+   redirection. */
+bool parse_redirects(char **args, struct redirs *r) {
+  memset(r, 0, sizeof(*r));
+  int out = 0;
+  for (int i = 0; args[i] != NULL; i++) {
+    struct redir red = {0};
+    size_t n = scan_operator(args[i], &red);
+    if (n == 0) {
+      unescape_word(args[i]);
+      args[out++] = args[i];
+      continue;
+    }
+    char *target = args[i][n] ? &args[i][n] : args[++i];
+    if (target == NULL) {
+      fprintf(stderr, "mythsh: syntax error: %s needs a target\n",
+              args[i - 1]);
+      goto fail;
+    }
+    if (r->count == MAX_REDIRS) {
+      fprintf(stderr, "mythsh: too many redirections\n");
+      goto fail;
+    }
+    unescape_word(target);
+    red.target = target;
+    if (red.kind == REDIR_DUP) {
+      char *end;
+      long fd = strtol(target, &end, 10);
+      if (end == target || *end != '\0' || fd < 0 || fd > INT_MAX) {
+        fprintf(stderr, "mythsh: %s: bad file descriptor\n", target);
+        goto fail;
+      }
+      red.target_fd = (int)fd;
+    } else if (red.kind == REDIR_HERESTRING) {
+      if (!strbuf_append(&red.body, target, strlen(target)) ||
+          !strbuf_append(&red.body, "\n", 1)) {
+        strbuf_free(&red.body);
+        goto fail;
+      }
+    }
+    r->items[r->count++] = red;
+  }
+  args[out] = NULL;
+  return true;
+
+fail:
+  args[0] = NULL;
+  redirs_free(r);
+  return false;
+}
+
+/* Collect here-document bodies: the lines after the command, up to one that
+   is exactly the delimiter. read_line returns false at end of input; a
+   missing delimiter just ends the body there. */
+void read_heredocs(struct redirs *r, line_reader read_line, void *ctx) {
+  char *line = NULL;
+  size_t size = 0;
+  for (int i = 0; i < r->count; i++) {
+    struct redir *red = &r->items[i];
+    if (red->kind != REDIR_HEREDOC)
+      continue;
+    while (read_line && read_line(ctx, &line, &size)) {
+      if (strcmp(line, red->target) == 0)
+        break;
+      strbuf_append(&red->body, line, strlen(line));
+      strbuf_append(&red->body, "\n", 1);
+    }
+  }
+  free(line);
+}
+
+void redirs_free(struct redirs *r) {
+  for (int i = 0; i < r->count; i++)
+    strbuf_free(&r->items[i].body);
+  r->count = 0;
+}
+
+/* A readable fd holding body. A memfd lives only in memory and takes any
+   size; where there is none, a pipe holds up to PIPE_BUF bytes. */
+static int here_fd(const struct strbuf *body) {
+  int fd = -1;
+#ifdef MFD_CLOEXEC
+  fd = memfd_create("mythsh-here", MFD_CLOEXEC);
+#endif
+  if (fd >= 0) {
+    if (write(fd, body->data ? body->data : "", body->len) !=
+            (ssize_t)body->len ||
+        lseek(fd, 0, SEEK_SET) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  int fds[2];
+  if (body->len > PIPE_BUF) {
+    errno = EFBIG;
+    return -1;
+  }
+  if (pipe(fds) != 0)
+    return -1;
+  if (write(fds[1], body->data ? body->data : "", body->len) !=
+      (ssize_t)body->len) {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  close(fds[1]);
+  return fds[0];
+}
+
+/* Apply the redirections to this process, in order. With save set, the
+   original of every fd touched is kept in r->saved so restore_redirects()
+   can put it back; that is how builtins run redirected without a fork.
+   Returns false, after reporting the failing target, if one can't be
+   opened. */
+bool apply_redirects(struct redirs *r, bool save) {
+  for (int i = 0; i < r->count; i++)
+    r->items[i].saved = REDIR_NOT_SAVED;
+  for (int i = 0; i < r->count; i++) {
+    struct redir *red = &r->items[i];
+    if (save) {
+      bool first = true;
+      for (int k = 0; k < i; k++) {
+        if (r->items[k].fd == red->fd)
+          first = false;
+      }
+      /* -1 if the fd wasn't open, so restoring closes it */
+      if (first)
+        red->saved = fcntl(red->fd, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+    }
+
+    int fd;
+    switch (red->kind) {
+    case REDIR_OUT:
+      fd = open(red->target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+      break;
+    case REDIR_APPEND:
+      fd = open(red->target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+      break;
+    case REDIR_IN:
+      fd = open(red->target, O_RDONLY | O_CLOEXEC);
+      break;
+    case REDIR_DUP:
+      if (dup2(red->target_fd, red->fd) < 0) {
+        fprintf(stderr, "mythsh: %d: %s\n", red->target_fd, strerror(errno));
+        return false;
+      }
+      continue;
+    default: // here-string or here-document
+      fd = here_fd(&red->body);
+      break;
+    }
+    if (fd < 0) {
+      fprintf(stderr, "mythsh: %s: %s\n",
+              red->kind == REDIR_HEREDOC || red->kind == REDIR_HERESTRING
+                  ? "here-document"
+                  : red->target,
+              strerror(errno));
+      return false;
+    }
+    if (fd != red->fd) {
+      dup2(fd, red->fd);
+      close(fd);
+    } else {
+      fcntl(fd, F_SETFD, 0); // it was closed; keep it across exec
+    }
+  }
+  return true;
+}
+
+/* Undo apply_redirects(r, true), including a partial one. */
+void restore_redirects(struct redirs *r) {
+  for (int i = r->count - 1; i >= 0; i--) {
+    struct redir *red = &r->items[i];
+    if (red->saved == REDIR_NOT_SAVED)
+      continue;
+    if (red->saved >= 0) {
+      dup2(red->saved, red->fd);
+      close(red->saved);
+    } else {
+      close(red->fd);
+    }
+    red->saved = REDIR_NOT_SAVED;
+  }
+}
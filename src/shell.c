@@ -0,0 +1,23 @@
+#include "shell.h"
+#include <string.h>
+
+void mythsh_init(struct mythsh *sh) {
+  memset(sh, 0, sizeof(*sh));
+  strcpy(sh->history_file, HISTORY_FILE);
+  history_init(&sh->history);
+  cmdmap_init(&sh->commands);
+  builtins_register(sh);
+  themes_init(sh);
+  strcpy(sh->current_prompt, "mythsh> "); // default prompt
+  sh->current_prompt_width = prompt_width(sh->current_prompt);
+}
+
+void mythsh_free(struct mythsh *sh) {
+  history_free(&sh->history);
+  cmdmap_free(&sh->commands);
+  themes_free(sh);
+  subst_cache_free(sh);
+  histdb_close(sh->histdb);
+  sh->histdb = NULL;
+  sh->history_index = 0;
+}
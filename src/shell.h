@@ -0,0 +1,160 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include "cmdmap.h"
+#include "histdb.h"
+#include "history.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+#define MAX_INPUTS 1024
+#define MAX_ARGS 64
+#define MAX_PROMPT 1024
+#define HISTORY_FILE ".mythsh_history"
+
+/* $(...) in a prompt template is rerun at most this often */
+#define PROMPT_SUBST_TTL_MS 2000
+#define PROMPT_SUBST_CACHE 8
+
+/* Prompt segments a theme can style: %u, %h, %d and %g in a setprompt
+   template, plus what %g shows outside a git repository. */
+enum { SEG_USER, SEG_HOST, SEG_DIR, SEG_GIT, SEG_NOGIT, SEG_COUNT };
+
+/* In segment formats %v is the segment's value and {a|b} picks a on UTF-8
+   terminals and b elsewhere. */
+struct theme {
+  char *name;
+  char *seg[SEG_COUNT];
+};
+
+struct mood {
+  char *name;
+  char *prompt;
+};
+
+/* Growable byte buffer; data is NUL-terminated once anything is in it. */
+struct strbuf {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+/* One redirection. target is the file name, here-document delimiter or
+   here-string word; body holds the text fed to a here-document/string. */
+enum redir_kind {
+  REDIR_OUT,        // [n]>file
+  REDIR_APPEND,     // [n]>>file
+  REDIR_IN,         // [n]<file
+  REDIR_DUP,        // [n]>&m
+  REDIR_HERESTRING, // <<<word
+  REDIR_HEREDOC,    // <<DELIM
+};
+#define REDIR_NOT_SAVED -2
+
+struct redir {
+  enum redir_kind kind;
+  int fd;
+  const char *target; // points into the parsed line
+  int target_fd;      // REDIR_DUP
+  struct strbuf body;
+  int saved; // copy of the original fd while a builtin runs
+};
+
+#define MAX_REDIRS 8
+
+struct redirs {
+  int count;
+  struct redir items[MAX_REDIRS];
+};
+
+/* Supplies the lines after a command, for here-documents, into a growable
+   *buf as getline() does. Returns false at end of input. */
+typedef bool (*line_reader)(void *ctx, char **buf, size_t *size);
+
+/* Output of one $(...) from a prompt template. */
+struct subst_cache {
+  char *cmd;
+  char *cwd; // the directory it ran in
+  char *output;
+  long long expires; // CLOCK_MONOTONIC ms
+};
+
+/* Everything the shell keeps between commands. main() owns one of these;
+   benchmarks and tools can create as many as they like. */
+struct mythsh {
+  struct cmdmap commands; // builtins and aliases
+
+  struct theme *themes;
+  int theme_count;
+  int theme; // index of the current theme
+  struct mood *moods;
+  int mood_count;
+
+  char history_file[PATH_MAX];
+  struct history history;
+  int history_index; // entry shown by Up/Down; history.count means none
+  struct histdb *histdb; // structured log, NULL unless 'hist on'
+
+  char current_prompt[MAX_PROMPT];
+  size_t current_prompt_width; // columns of its last line, for the editor
+  char current_prompt_template[MAX_PROMPT]; // empty means no dynamic template
+  bool has_prompt_template;
+  struct subst_cache prompt_subst[PROMPT_SUBST_CACHE];
+};
+
+void mythsh_init(struct mythsh *sh);
+void mythsh_free(struct mythsh *sh);
+
+/* parse.c */
+bool parse_input(char *input, char **args);
+void parse_command(struct mythsh *sh, const char *input, struct strbuf *store,
+                   char **args);
+
+/* redirect.c */
+bool parse_redirects(char **args, struct redirs *r);
+void read_heredocs(struct redirs *r, line_reader read_line, void *ctx);
+void redirs_free(struct redirs *r);
+bool apply_redirects(struct redirs *r, bool save);
+void restore_redirects(struct redirs *r);
+
+/* exec.c */
+pid_t spawn_command(struct mythsh *sh, char **args, struct redirs *r,
+                    int out_fd);
+
+/* subst.c */
+bool strbuf_append(struct strbuf *b, const char *s, size_t n);
+void strbuf_free(struct strbuf *b);
+bool capture_command(struct mythsh *sh, const char *cmd, struct strbuf *out);
+bool expand_substitutions(struct mythsh *sh, const char *in,
+                          struct strbuf *out);
+size_t prompt_substitution(struct mythsh *sh, const char *s,
+                           const char **output);
+void subst_cache_free(struct mythsh *sh);
+
+/* prompt.c */
+size_t build_prompt(struct mythsh *sh, const char *input_template,
+                    char *output);
+size_t prompt_width(const char *prompt);
+void unescape_prompt(char *str, size_t size);
+
+/* themes.c */
+void themes_init(struct mythsh *sh);
+void themes_free(struct mythsh *sh);
+int theme_find(const struct mythsh *sh, const char *name);
+bool theme_define(struct mythsh *sh, const char *name, const char *segment,
+                  const char *format);
+const struct mood *mood_find(const struct mythsh *sh, const char *name);
+bool mood_define(struct mythsh *sh, const char *name, const char *prompt);
+
+/* builtins.c */
+void builtins_register(struct mythsh *sh);
+int handle_builtin(struct mythsh *sh, char **args, struct redirs *r);
+void load_myshrc(struct mythsh *sh);
+
+#endif
@@ -0,0 +1,245 @@
+#include "shell.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static bool sb_reserve(struct strbuf *b, size_t extra) {
+  if (b->len + extra + 1 <= b->cap)
+    return true;
+  size_t cap = b->cap ? b->cap * 2 : 256;
+  while (cap < b->len + extra + 1)
+    cap *= 2;
+  char *data = realloc(b->data, cap);
+  if (!data)
+    return false;
+  b->data = data;
+  b->cap = cap;
+  return true;
+}
+
+bool strbuf_append(struct strbuf *b, const char *s, size_t n) {
+  if (!sb_reserve(b, n))
+    return false;
+  memcpy(b->data + b->len, s, n);
+  b->len += n;
+  b->data[b->len] = '\0';
+  return true;
+}
+
+void strbuf_free(struct strbuf *b) {
+  free(b->data);
+  memset(b, 0, sizeof(*b));
+}
+
+/* Append s to out with a backslash before every < and >, so that
+   parse_redirects() takes them as plain characters. */
+static bool append_escaped(struct strbuf *out, const char *s, size_t n) {
+  while (n > 0) {
+    size_t k = strcspn(s, "<>");
+    if (k > n)
+      k = n;
+    if (!strbuf_append(out, s, k))
+      return false;
+    if (k == n)
+      break;
+    if (!strbuf_append(out, "\\", 1) || !strbuf_append(out, s + k, 1))
+      return false;
+    s += k + 1;
+    n -= k + 1;
+  }
+  return true;
+}
+
+/* Length of the body of a $(...) given what follows the "$(", or -1 if the
+   closing parenthesis is missing. Parentheses nest, so $(a $(b)) works. */
+static long body_length(const char *s) {
+  int depth = 1;
+  for (const char *p = s; *p; p++) {
+    if (*p == '(') {
+      depth++;
+    } else if (*p == ')' && --depth == 0) {
+      return p - s;
+    }
+  }
+  return -1;
+}
+
+/* Run cmd and append what it writes to stdout to out, minus trailing
+   newlines. The output is read straight from a pipe; nothing touches the
+   disk. */
+bool capture_command(struct mythsh *sh, const char *cmd, struct strbuf *out) {
+  struct strbuf store = {0};
+  struct redirs redirs;
+  char *args[MAX_ARGS];
+  parse_command(sh, cmd, &store, args);
+  if (!parse_redirects(args, &redirs) || args[0] == NULL) {
+    redirs_free(&redirs);
+    strbuf_free(&store);
+    return true;
+  }
+
+  /* close-on-exec so only the child's stdout keeps the write end open */
+  int fds[2];
+  if (pipe(fds) != 0 || fcntl(fds[0], F_SETFD, FD_CLOEXEC) != 0 ||
+      fcntl(fds[1], F_SETFD, FD_CLOEXEC) != 0) {
+    perror("mythsh: pipe");
+    redirs_free(&redirs);
+    strbuf_free(&store);
+    return false;
+  }
+  pid_t pid = spawn_command(sh, args, &redirs, fds[1]);
+  close(fds[1]);
+  redirs_free(&redirs);
+  strbuf_free(&store);
+
+  size_t start = out->len;
+  bool ok = pid > 0;
+  while (ok) {
+    if (!sb_reserve(out, 4096)) {
+      ok = false;
+      break;
+    }
+    ssize_t n = read(fds[0], out->data + out->len, out->cap - out->len - 1);
+    if (n > 0)
+      out->len += n;
+    else if (n == 0 || errno != EINTR)
+      break;
+  }
+  close(fds[0]);
+  if (pid > 0) {
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  while (out->len > start && out->data[out->len - 1] == '\n')
+    out->len--;
+  if (out->data)
+    out->data[out->len] = '\0';
+  return ok;
+}
+
+/* Copy in to out with every $(cmd) replaced by the output of cmd, its < and
+   > escaped so redirections only come from what was typed. \$( is
+   copied through as a literal $( up to its closing parenthesis, which is how
+   a substitution gets into a setprompt template without running right away;
+   its < and > are escaped so they stay part of that text. An unterminated $(
+   is kept as is. */
+bool expand_substitutions(struct mythsh *sh, const char *in,
+                          struct strbuf *out) {
+  out->len = 0;
+  if (!sb_reserve(out, strlen(in)))
+    return false;
+  out->data[0] = '\0';
+
+  const char *p = in;
+  while (*p) {
+    bool literal = p[0] == '\\' && p[1] == '$' && p[2] == '(';
+    if (literal || (p[0] == '$' && p[1] == '(')) {
+      const char *body = literal ? p + 3 : p + 2;
+      long len = body_length(body);
+      if (len < 0)
+        return strbuf_append(out, p, strlen(p));
+      if (literal) {
+        if (!append_escaped(out, p + 1, len + 3))
+          return false;
+      } else {
+        /* output is data: escape it so no '>' in it becomes a redirection */
+        struct strbuf output = {0};
+        char *cmd = strndup(body, len);
+        bool ok = cmd && capture_command(sh, cmd, &output) &&
+                  append_escaped(out, output.data ? output.data : "",
+                                 output.len);
+        free(cmd);
+        strbuf_free(&output);
+        if (!ok)
+          return false;
+      }
+      p = body + len + 1;
+      continue;
+    }
+    size_t n = strcspn(p, "$\\");
+    if (n == 0)
+      n = 1;
+    if (!strbuf_append(out, p, n))
+      return false;
+    p += n;
+  }
+  return true;
+}
+
+static long long now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* If s starts with a $(...), point *output at that command's output and
+   return the length of the $(...) text, else return 0. Outputs are cached
+   per command and directory for PROMPT_SUBST_TTL_MS, so redrawing the
+   prompt doesn't rerun them. */
+size_t prompt_substitution(struct mythsh *sh, const char *s,
+                           const char **output) {
+  if (s[0] != '$' || s[1] != '(')
+    return 0;
+  long len = body_length(s + 2);
+  if (len < 0)
+    return 0;
+
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    strcpy(cwd, ".");
+  long long now = now_ms();
+
+  /* reuse a fresh entry, else refill the stalest one */
+  struct subst_cache *slot = &sh->prompt_subst[0];
+  for (int k = 0; k < PROMPT_SUBST_CACHE; k++) {
+    struct subst_cache *c = &sh->prompt_subst[k];
+    if (c->cmd && strncmp(c->cmd, s + 2, len) == 0 && c->cmd[len] == '\0' &&
+        strcmp(c->cwd, cwd) == 0) {
+      if (c->expires > now) {
+        *output = c->output;
+        return len + 3;
+      }
+      slot = c;
+      break;
+    }
+    if (c->expires < slot->expires)
+      slot = c;
+  }
+
+  struct strbuf out = {0};
+  char *cmd = strndup(s + 2, len);
+  if (cmd)
+    capture_command(sh, cmd, &out);
+  free(slot->cmd);
+  free(slot->cwd);
+  free(slot->output);
+  slot->cmd = cmd;
+  slot->cwd = strdup(cwd);
+  slot->output = out.data ? out.data : strdup("");
+  slot->expires = now + PROMPT_SUBST_TTL_MS;
+  if (!slot->cmd || !slot->cwd || !slot->output) {
+    free(slot->cmd);
+    free(slot->cwd);
+    free(slot->output);
+    memset(slot, 0, sizeof(*slot));
+    *output = "";
+  } else {
+    *output = slot->output;
+  }
+  return len + 3;
+}
+
+void subst_cache_free(struct mythsh *sh) {
+  for (int k = 0; k < PROMPT_SUBST_CACHE; k++) {
+    free(sh->prompt_subst[k].cmd);
+    free(sh->prompt_subst[k].cwd);
+    free(sh->prompt_subst[k].output);
+  }
+  memset(sh->prompt_subst, 0, sizeof(sh->prompt_subst));
+}
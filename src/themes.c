@@ -0,0 +1,175 @@
+#include "shell.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Built-in themes. In segment formats %v is the segment's value and {a|b}
+   picks a on UTF-8 terminals and b elsewhere. */
+static const struct {
+  const char *name;
+  const char *seg[SEG_COUNT];
+} default_themes[] = {
+    {"mini",
+     {
+         [SEG_USER] = "\033[1;38;5;81m[\033[0m\033[38;5;117m{\uf007|usr} "
+                      "%v\033[0m\033[1;38;5;81m]\033[0m ",
+         [SEG_HOST] = "\033[1;38;5;214m[\033[0m\033[38;5;222m{\uf233|host} "
+                      "%v\033[0m\033[1;38;5;214m]\033[0m",
+         [SEG_DIR] = "\033[1;38;5;213m[\033[0m\033[38;5;219m{\uf07c|dir} "
+                     "%v\033[0m\033[1;38;5;213m]\033[0m",
+         [SEG_GIT] = "\033[1;38;5;114m[\033[0m\033[38;5;120m{\ue725|git} "
+                     "%v\033[0m\033[1;38;5;114m]\033[0m",
+         [SEG_NOGIT] = "{\033[38;5;240m\ue0b0\033[0m|-}",
+     }},
+    {"graphic",
+     {
+         [SEG_USER] = "\033[48;5;74m\033[38;5;232m %v "
+                      "\033[0m{\033[38;5;74m\ue0b0\033[0m| | }",
+         [SEG_HOST] = "\033[48;5;208m\033[38;5;232m %v "
+                      "\033[0m{\033[38;5;208m\ue0b0\033[0m| | }",
+         [SEG_DIR] = "\033[48;5;183m\033[38;5;232m %v "
+                     "\033[0m{\033[38;5;183m\ue0b0\033[0m| | }",
+         [SEG_GIT] = "\033[48;5;114m\033[38;5;232m %v "
+                     "\033[0m{\033[38;5;114m\ue0b0\033[0m| | }",
+         [SEG_NOGIT] = "{\033[38;5;240m\ue0b0\033[0m|-}",
+     }},
+};
+
+/* Built-in moods (predefined prompts). */
+static const struct {
+  const char *name;
+  const char *prompt;
+} default_moods[] = {
+    {"hacker", "╭─\033[48;5;208m\033[38;5;232m \uf21b "
+               "\033[0m\033[38;5;208m\ue0b0\033[0m mythsh-hacker "
+               "\033[38;5;208m\ue0b0\033[0m\n"
+               "╰─\uf061 "},
+    {"chill", "╭─\033[48;5;74m\033[38;5;232m \uea85 "
+              "\033[0m\033[38;5;74m\ue0b0\033[0m mythsh-chill "
+              "\033[38;5;74m\ue0b0\033[0m\n"
+              "╰─\uf061 "},
+    {"gamer", "╭─\033[48;5;170m\033[38;5;232m \uf11b "
+              "\033[0m\033[38;5;170m\ue0b0\033[0m mythsh-gamer "
+              "\033[38;5;170m\ue0b0\033[0m\n"
+              "╰─\uf061 "},
+    {"lofi", "╭─\033[48;5;183m\033[38;5;232m \uf001 "
+             "\033[0m\033[38;5;183m\ue0b0\033[0m mythsh-lofi "
+             "\033[38;5;183m\ue0b0\033[0m\n"
+             "╰─\uf061 "},
+    {"ghoul", "╭─\033[48;5;250m\033[38;5;232m \ueefe "
+              "\033[0m\033[38;5;250m\ue0b0\033[0m mythsh-ghoul "
+              "\033[38;5;250m\ue0b0\033[0m\n"
+              "╰─\uf061 "},
+};
+
+/* Segment names as used by 'theme <name> <segment> <format>'; the first four
+   may also be given as their template letter (u, h, d, g). */
+static const char *segment_names[SEG_COUNT] = {
+    [SEG_USER] = "user", [SEG_HOST] = "host", [SEG_DIR] = "dir",
+    [SEG_GIT] = "git",   [SEG_NOGIT] = "nogit",
+};
+static const char segment_letters[SEG_COUNT] = {
+    [SEG_USER] = 'u', [SEG_HOST] = 'h', [SEG_DIR] = 'd', [SEG_GIT] = 'g'};
+
+void themes_init(struct mythsh *sh) {
+  for (size_t i = 0; i < sizeof(default_themes) / sizeof(default_themes[0]);
+       i++) {
+    for (int s = 0; s < SEG_COUNT; s++)
+      theme_define(sh, default_themes[i].name, segment_names[s],
+                   default_themes[i].seg[s]);
+  }
+  sh->theme = 0; // mini
+  for (size_t i = 0; i < sizeof(default_moods) / sizeof(default_moods[0]); i++)
+    mood_define(sh, default_moods[i].name, default_moods[i].prompt);
+}
+
+void themes_free(struct mythsh *sh) {
+  for (int i = 0; i < sh->theme_count; i++) {
+    free(sh->themes[i].name);
+    for (int s = 0; s < SEG_COUNT; s++)
+      free(sh->themes[i].seg[s]);
+  }
+  for (int i = 0; i < sh->mood_count; i++) {
+    free(sh->moods[i].name);
+    free(sh->moods[i].prompt);
+  }
+  free(sh->themes);
+  free(sh->moods);
+  sh->themes = NULL;
+  sh->moods = NULL;
+  sh->theme_count = sh->mood_count = 0;
+}
+
+int theme_find(const struct mythsh *sh, const char *name) {
+  for (int i = 0; i < sh->theme_count; i++) {
+    if (strcmp(sh->themes[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/* Set one segment format of a theme. A new theme starts as a copy of the
+   first one, so it only needs to override what differs. Returns false for an
+   unknown segment name or when out of memory. */
+bool theme_define(struct mythsh *sh, const char *name, const char *segment,
+                  const char *format) {
+  int seg = -1;
+  for (int s = 0; s < SEG_COUNT; s++) {
+    if (strcmp(segment, segment_names[s]) == 0 ||
+        (segment[0] == segment_letters[s] && segment[1] == '\0'))
+      seg = s;
+  }
+  if (seg < 0)
+    return false;
+
+  int t = theme_find(sh, name);
+  if (t < 0) {
+    struct theme *themes =
+        realloc(sh->themes, (sh->theme_count + 1) * sizeof(*themes));
+    if (!themes)
+      return false;
+    sh->themes = themes;
+    struct theme *th = &themes[sh->theme_count];
+    memset(th, 0, sizeof(*th));
+    th->name = strdup(name);
+    for (int s = 0; s < SEG_COUNT && sh->theme_count > 0; s++)
+      th->seg[s] = strdup(themes[0].seg[s]);
+    t = sh->theme_count++;
+  }
+
+  char *copy = strdup(format);
+  if (!copy)
+    return false;
+  free(sh->themes[t].seg[seg]);
+  sh->themes[t].seg[seg] = copy;
+  return true;
+}
+
+const struct mood *mood_find(const struct mythsh *sh, const char *name) {
+  for (int i = 0; i < sh->mood_count; i++) {
+    if (strcmp(sh->moods[i].name, name) == 0)
+      return &sh->moods[i];
+  }
+  return NULL;
+}
+
+bool mood_define(struct mythsh *sh, const char *name, const char *prompt) {
+  char *copy = strdup(prompt);
+  if (!copy)
+    return false;
+  struct mood *m = (struct mood *)mood_find(sh, name);
+  if (!m) {
+    struct mood *moods =
+        realloc(sh->moods, (sh->mood_count + 1) * sizeof(*moods));
+    if (!moods) {
+      free(copy);
+      return false;
+    }
+    sh->moods = moods;
+    m = &moods[sh->mood_count++];
+    m->name = strdup(name);
+    m->prompt = NULL;
+  }
+  free(m->prompt);
+  m->prompt = copy;
+  return true;
+}
@@ -0,0 +1,19 @@
+#ifndef WIDTH_H
+#define WIDTH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Decode the UTF-8 sequence at s (n > 0 bytes available) into *cp and
+   return its length. A malformed byte decodes as U+FFFD with length 1. */
+size_t utf8_decode(const char *s, size_t n, uint32_t *cp);
+
+/* Terminal columns a code point takes: 0 for control and combining
+   characters, 2 for wide ones (CJK, emoji), 1 for everything else. */
+int codepoint_width(uint32_t cp);
+
+/* Columns taken by n bytes of UTF-8 text. ANSI escape sequences take none;
+   newlines are not treated specially. */
+size_t display_width(const char *s, size_t n);
+
+#endif